@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+#
+# Benchmarks of the maze solver on generated mazes
+# Mazes are made by maze_bench (see maze_bench.c) with a fixed seed, so every run measures the same mazes
+# Usage:
+#     make bench
+#     python3 ./bench.py --max-cells 1e8 --kinds perfect,serpentine --output bench.json
+#
+# Every run prints one JSON object per line (and writes them into --output):
+#     {"kind", "rows", "cols", "cells", "mode", "seconds", "peak_rss_kb", "exit_code", ...}
+# "load" is --rpath from a position outside of the maze, the maze is read and validated and nothing else
+# --test and load report "cells_per_second", paths report "steps" and "steps_per_second" which leave out the load time
+
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+from subprocess import run, PIPE
+
+KINDS = ["perfect", "braided", "open", "serpentine"]
+MODES = ["load", "--test", "--rpath", "--lpath", "--shortest"]
+# Bytes of a single step in --format binary output
+STEP_BYTES = 8
+
+
+def maze_sizes(min_cells: float, max_cells: float):
+    # Roughly square mazes, ten times more cells every size, --test rejects mazes with as many rows as cols
+    cells = int(min_cells)
+    while cells <= max_cells:
+        rows = max(1, int(cells ** 0.5))
+        cols = max(2, cells // rows)
+        yield rows, cols + 1 if cols == rows else cols
+        cells *= 10
+
+
+def run_measured(helper, command, output_path):
+    # Runs command through "maze_bench run" and returns seconds, peak RSS in KiB, exit code and the size of stdout
+    with open(output_path, "wb") as output:
+        process = run([helper, "run"] + command, stdout=output, stderr=PIPE, check=True)
+    measured = json.loads(process.stderr)
+    return measured["seconds"], measured["peak_rss_kb"], measured["exit_code"], os.path.getsize(output_path)
+
+
+def bench_maze(args, kind, rows, cols, directory):
+    maze_path = os.path.join(directory, f"{kind}_{rows}x{cols}.txt")
+    with open(maze_path, "wb") as maze:
+        run([args.helper, "generate", kind, str(rows), str(cols), str(args.seed)], stdout=maze, check=True)
+
+    cells = rows * cols
+    path_output = os.path.join(directory, "path.bin")
+    load_seconds = None
+    for mode in MODES:
+        if mode == "load":
+            command = [args.maze, "--rpath", "0", "0", maze_path]
+        elif mode == "--test":
+            command = [args.maze, "--test", maze_path]
+        else:
+            command = [args.maze, "--format", "binary", mode, "1", "1", maze_path]
+
+        best = None
+        for _ in range(args.repeat):
+            measured = run_measured(args.helper, command, path_output)
+            if best is None or measured[0] < best[0]:
+                best = measured
+        seconds, peak_rss, exit_code, size = best
+
+        result = {"kind": kind, "rows": rows, "cols": cols, "cells": cells, "mode": mode.lstrip("-"),
+                  "seconds": round(seconds, 6), "peak_rss_kb": peak_rss, "exit_code": exit_code}
+        if mode in ("load", "--test"):
+            result["cells_per_second"] = round(cells / seconds)
+            if mode == "load":
+                load_seconds = seconds
+        else:
+            steps = max(0, size // STEP_BYTES - 1)
+            walk_seconds = seconds - load_seconds
+            result["steps"] = steps
+            result["steps_per_second"] = round(steps / walk_seconds) if walk_seconds > 0 else None
+        yield result
+    os.remove(maze_path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks of the maze solver on generated mazes")
+    parser.add_argument("--maze", default="./maze", help="solver binary")
+    parser.add_argument("--helper", default="./maze_bench", help="maze_bench binary")
+    parser.add_argument("--kinds", default=",".join(KINDS), help="comma separated maze kinds")
+    parser.add_argument("--min-cells", type=float, default=1e3)
+    parser.add_argument("--max-cells", type=float, default=1e7)
+    parser.add_argument("--seed", type=int, default=2023)
+    parser.add_argument("--repeat", type=int, default=3, help="runs of every mode, the fastest one is reported")
+    parser.add_argument("--output", default="bench.json", help="file the JSON lines are written into")
+    args = parser.parse_args()
+
+    kinds = args.kinds.split(",")
+    for kind in kinds:
+        if kind not in KINDS:
+            sys.exit(f"Unknown maze kind {kind}, use one of {', '.join(KINDS)}")
+
+    with tempfile.TemporaryDirectory(prefix="maze-bench-") as directory, open(args.output, "w") as output:
+        for rows, cols in maze_sizes(args.min_cells, args.max_cells):
+            for kind in kinds:
+                for result in bench_maze(args, kind, rows, cols, directory):
+                    line = json.dumps(result)
+                    print(line, flush=True)
+                    output.write(line + "\n")
+
+
+if __name__ == "__main__":
+    main()
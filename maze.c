@@ -1,17 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <math.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 
 // CONSTANTS
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
+#define EXIT_LOOPED 2 // Path goes around in circles and never leaves the maze
+#define EXIT_STEP_LIMIT 3 // Path didn't leave the maze within --max-steps
+
+// Result of validation done by map_ctor while reading a maze
+typedef enum {
+    MAZE_VALID,
+    MAZE_WRONG_BORDERS, // Adjacent triangles don't agree on a shared border
+} MazeValidity;
+
+// How borders of the triangles are kept inside Map, chosen by --storage
+typedef enum {
+    MAP_STORAGE_BYTES, // A packed byte per triangle inside cells
+    MAP_STORAGE_PLANES, // A bit per triangle in each of the three bit planes inside planes
+    MAP_STORAGE_TILES, // Tiles of packed bytes read from the maze file on demand into a bounded TileCache
+} MapStorage;
+
+struct TileCache;
+
+// Read-only view of a whole file, either mmap'd or (for pipes and other unmappable files) read into a buffer
+typedef struct {
+    const char *data;
+    const char *end;
+    void *memory;
+    size_t size;
+    bool isMapped;
+} FileView;
 
 typedef struct {
     int rows;
     int cols;
-    unsigned char *cells;
+    MapStorage storage;
+    unsigned char *cells; // MAP_STORAGE_BYTES only
+    uint64_t *planes; // MAP_STORAGE_PLANES only, planes of LEFT_BIT, RIGHT_BIT and UPDOWN_BIT one after another
+    size_t planeStride; // Words in a row of a plane, every row starts at a PLANE_ALIGNMENT boundary
+    MazeValidity validity;
+    int invalidRow; // Position of the first inconsistent border, only set when validity != MAZE_VALID
+    int invalidCol;
+    FileView *compiled; // Compiled maze cells are mapped from (see map_from_tmaze), NULL for text mazes
+    bool isTmaze; // Loaded from a compiled maze, whatever its storage, compiled is only set with MAP_STORAGE_BYTES
+    struct TileCache *tiles; // MAP_STORAGE_TILES only
 } Map;
 
 // Represents bit indexes borders needed values from 0-2
@@ -21,6 +74,16 @@ typedef enum {
     UPDOWN_BIT, // Up or Down border
 } BitIndex;
 
+// Map.cells keep borders in bits 0-2, map_ctor packs the rest of the triangle into the bits above them
+#define BORDER_MASK 0x07
+#define ORIENTATION_BIT 3 // Set for CONTAINS_DOWN triangles
+#define BOUNDARY_SHIFT 4 // Maze boundary bits (LEFT_BIT, RIGHT_BIT, UPDOWN_BIT) moved up by BOUNDARY_SHIFT
+#define PACKED_CELL_VALUES 128
+
+// Alignment in bytes of every row of Map.planes, a row always fills whole PlaneBlocks
+#define PLANE_ALIGNMENT 64
+#define PLANE_ALIGNMENT_WORDS (PLANE_ALIGNMENT / sizeof(uint64_t))
+
 // Symbolizes all possible directions for which to solve maze
 typedef enum {
     L = 1, // LEFT 
@@ -44,6 +107,14 @@ typedef enum {
     CONTAINS_DOWN,
 } TriangleType;
 
+// Represents sides of a triangle, the third side is either UP or DOWN depending on TriangleType
+typedef enum {
+    LEFT_SIDE,
+    RIGHT_SIDE,
+    VERTICAL_SIDE,
+    NUM_OF_SIDES,
+} Side;
+
 // Defines a triangle
 typedef struct {
     Position pos;
@@ -52,8 +123,120 @@ typedef struct {
     unsigned mazeBoundary; // Explaines sides of a triangle that act as outside maze boundaries
 } Triangle;
 
+// Results of triangle_move_in
+typedef enum {
+    MOVE_WRONG_DIRECTION = -2, // Triangle doesn't have a side in that direction
+    MOVE_BLOCKED = -1, // Border is in the way
+    MOVE_SUCCESS = 0,
+    MOVE_LEFT_MAZE = 1, // Triangle would've moved outside the maze
+} MoveResult;
+
+// Results of search_maze
+typedef enum {
+    SEARCH_ERROR = -1,
+    SEARCH_FOUND = 0, // Path left the maze
+    SEARCH_LOOPED = 1, // Path came back to a triangle and left it through the same side again
+    SEARCH_STEP_LIMIT = 2, // Path used up all moves allowed by --max-steps
+} SearchResult;
+
 // A Global variable that can be initialized by using map_ctor function
 
+// Set by --verbose, diagnostics of the move and border primitives are printed only when it's enabled
+bool verboseOutput = false;
+
+// Prints a diagnostic message onto stderr when --verbose is used
+void verbose_error(const char *format, ...)
+{
+    if(!verboseOutput){
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+// Longest error message --test-many keeps as the reason of an invalid file
+#define ERROR_REASON_SIZE 160
+
+// First error message of a file validated by --test-many
+typedef struct {
+    char text[ERROR_REASON_SIZE];
+    bool isSet;
+} ErrorCapture;
+
+// Set on the threads of --test-many, error_print keeps messages here while it isn't NULL
+_Thread_local ErrorCapture *errorCapture = NULL;
+
+// Prints an error message about the maze onto stderr, or keeps it in errorCapture unless it already holds one
+void error_print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    if(errorCapture == NULL){
+        vfprintf(stderr, format, args);
+    } else if(!errorCapture->isSet){
+        vsnprintf(errorCapture->text, sizeof(errorCapture->text), format, args);
+        errorCapture->isSet = true;
+    }
+    va_end(args);
+}
+
+// Counters and timers behind --stats are compiled in unless the build sets MAZE_STATS to 0
+#ifndef MAZE_STATS
+#define MAZE_STATS 1
+#endif
+
+//
+// Work done by the program, printed by --stats as a JSON line onto stderr when the program ends
+// Hot loops count into locals and add them here once per call, so the counters cost next to nothing
+//
+typedef struct {
+    uint64_t bytesParsed; // Maze text read by scan_cells, tile indexing and the bands of --test
+    uint64_t cellsValidated;
+    uint64_t steps; // Moves of --rpath and --lpath
+    uint64_t blockedProbes; // Sides the hand rule tried and found a border in
+    uint64_t revisits; // Triangles a walk leaves again, cells a breadth-first search reaches again
+    uint64_t expanded; // Cells taken from the queue of --shortest
+    uint64_t loadNs; // Time spent in map_ctor
+    uint64_t validateNs; // Time spent in test
+    uint64_t searchNs; // Time spent in search_maze and shortest_path
+} Stats;
+
+Stats stats;
+
+// Set by --stats
+bool statsOutput = false;
+
+#if MAZE_STATS
+// Adds value to a counter of stats, safe to use from worker threads
+#define STATS_ADD(counter, value) __atomic_fetch_add(&stats.counter, (uint64_t)(value), __ATOMIC_RELAXED)
+#define STATS_NOW() stats_now()
+#else
+#define STATS_ADD(counter, value) ((void)(value))
+#define STATS_NOW() 0
+#endif
+
+// Monotonic time in nanoseconds used by the timers of stats
+static inline uint64_t stats_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Prints stats onto stderr, registered with atexit by --stats
+void stats_print()
+{
+    fprintf(stderr, "{\"bytes_parsed\": %llu, \"cells_validated\": %llu, \"steps\": %llu, \"blocked_probes\": %llu, "
+                    "\"revisits\": %llu, \"expanded\": %llu, \"load_seconds\": %.6f, \"validate_seconds\": %.6f, "
+                    "\"search_seconds\": %.6f}\n",
+            (unsigned long long)stats.bytesParsed, (unsigned long long)stats.cellsValidated,
+            (unsigned long long)stats.steps, (unsigned long long)stats.blockedProbes,
+            (unsigned long long)stats.revisits, (unsigned long long)stats.expanded,
+            stats.loadNs / 1e9, stats.validateNs / 1e9, stats.searchNs / 1e9);
+}
+
 // Prints help onto the screen when using --help option
 void printHelp()
 {
@@ -63,9 +246,13 @@ void printHelp()
            "\n"
            "maze is a program that solves a triangular maze using either the right or left hand rules.\n"
            "\n"
-           "Usage: ./maze [OPTION]\n"
+           "Usage: ./maze [OPTIONS] MODE\n"
            "  --help            Shows help info\n"
            "  --test file.txt   Tests the validity of a file. Prints either 'Valid' or 'Invalid'.\n"
+           "  --test-many PATH...\n"
+           "                    Tests every file, every file inside directories and every member of '.tar' archives\n"
+           "                    given as PATH, on --threads threads. Prints 'PATH: Valid' or 'PATH: Invalid: REASON'\n"
+           "                    for each of them in the order they were given, directories in the order of names.\n"
            "  --rpath R C file.txt\n"
            "                    Solves the maze using the right hand rule.\n"
            "                    R(INT) and C(INT) specify the row and column of the starting position.\n"
@@ -78,621 +265,6910 @@ void printHelp()
            "                    Finds the shortest path in the maze.\n"
            "                    R(INT) and C(INT) specify the row and column of the starting position.\n"
            "                    'file.txt'(FILE) is a matrix of the maze to be solved.\n"
+           "  --components file.txt\n"
+           "                    Labels the connected parts of the maze and saves them next to it into\n"
+           "                    'file.txt.components', which turns --viable and --reachable into a single lookup.\n"
+           "  --viable R C file.txt\n"
+           "                    Prints 'Viable' if a way out of the maze can be reached from R C, otherwise 'Not viable'.\n"
+           "  --reachable R C R2 C2 file.txt\n"
+           "                    Prints 'Reachable' if R2 C2 can be reached from R C, otherwise 'Unreachable'.\n"
+           "  --distance-field file.txt\n"
+           "                    Measures the distance from every triangle to its closest exits and saves it next to\n"
+           "                    the maze into 'file.txt.distances', --shortest then follows it without any search.\n"
+           "  --corridors file.txt\n"
+           "                    Finds chains of triangles the hand rule can only pass straight through and saves them\n"
+           "                    into 'file.txt.corridors'. --rpath and --lpath with '--format length' then cross each\n"
+           "                    of them in one move, which pays off in mazes of long corridors. Other formats print\n"
+           "                    every position and walk every triangle.\n"
+           "  --apply-patch patch.txt file.txt\n"
+           "                    Changes borders of the maze in place, lines of 'patch.txt'(FILE) are 'set R C SIDE'\n"
+           "                    or 'clear R C SIDE' where SIDE is left, right or vertical, the neighbouring triangle\n"
+           "                    changes along with R C. Up to date '.components' and '.distances' files are updated too,\n"
+           "                    a '.corridors' file is ignored until it's built again.\n"
+           "  --compile file.txt out.tmaze\n"
+           "                    Validates the maze once and saves it with its components into a binary file,\n"
+           "                    every mode accepts 'out.tmaze' in place of 'file.txt' and maps it without parsing.\n"
+           "  --batch queries.txt file.txt\n"
+           "                    Loads the maze once and answers every line of 'queries.txt'(FILE),\n"
+           "                    lines are 'rpath R C', 'lpath R C' or 'shortest R C'.\n"
+           "                    Every result is printed as '> QUERY', the path and '< RESULT'\n"
+           "                    where RESULT is found, looped, step-limit or error.\n"
+           "  --decode-path file\n"
+           "                    Prints the path saved by '--format packed' or '--format rle' into 'file'.\n"
+           "  --serve socket\n"
+           "                    Answers requests of clients connected to the Unix socket 'socket' until it's stopped\n"
+           "                    by SIGINT or SIGTERM, mazes stay loaded until their files change. Request lines are\n"
+           "                    'test FILE', 'rpath R C FILE', 'lpath R C FILE' or 'shortest R C FILE', every answer\n"
+           "                    is '> REQUEST', the path (or Valid / Invalid) and '< RESULT' like --batch prints.\n"
+           "\n"
+           "Options placed before the mode:\n"
+           "  --verbose         Prints diagnostics of blocked moves and invalid cells onto stderr.\n"
+           "  --stats           Prints bytes parsed, cells validated, steps, blocked probes, revisits and the time\n"
+           "                    spent loading, validating and searching as a JSON line onto stderr at the end.\n"
+           "  --format FORMAT   Format of printed paths, 'text' (default) prints 'R,C' lines,\n"
+           "                    'binary' prints pairs of little endian uint32 R and C, 'packed' prints the first\n"
+           "                    position and 2 bits for every move, 'rle' also shortens runs of the same move,\n"
+           "                    'length' prints only the number of positions.\n"
+           "  --search KIND     How --shortest searches, 'bfs' (default) expands cells in order of distance,\n"
+           "                    'bidirectional' also searches back from the exits, 'astar' heads for the closest edge.\n"
+           "                    All of them find a path of the same length, not always the same one.\n"
+           "  --threads N       Number of threads used by --batch, --test and --test-many (default 1),\n"
+           "                    with --serve the number of requests answered at once.\n"
+           "  --storage KIND    How the maze is kept in memory, 'bytes' (default) uses a byte per triangle,\n"
+           "                    'planes' uses three bit planes with a bit per triangle for very large mazes,\n"
+           "                    'tiles' reads 256x256 tiles from the file on demand for mazes larger than memory,\n"
+           "                    --rpath and --lpath walk up to 2^40 triangles with it.\n"
+           "  --memory-budget MB\n"
+           "                    MiB kept in memory by '--storage tiles' (default 64), half of it for tiles and half\n"
+           "                    for the triangles already left by --rpath and --lpath.\n"
+           "  --with-graph      Makes --compile also save the neighbours of every triangle used by --shortest.\n"
+           "  --max-steps N     Stops --rpath and --lpath after N moves, exits with status 3.\n"
+           "                    A path that goes around in circles is always stopped with status 2.\n"
            );
 }
 
-// Initializes Map structure and cells array, validates correctness of data contained in file (using function test), allocates Map and unsigned char *cells
-int map_ctor(Map **map, const char *fileName)
+//
+// Uses bitwise operations to determine a 0 / 1 state of a bit from a number
+//
+bool isolate_bit_value(unsigned eval, BitIndex bit)
 {
-    FILE *file = fopen(fileName, "r");
-    if(file == NULL){
-        fprintf(stderr, "Error opening file\n");
-        fclose(file);
-        return -1;
-    }
-
-    int rows = 0, cols = 0;
+    unsigned mask = 1U << bit;
+    return eval & mask ? true : false;
+}
 
-    if(fscanf(file, "%d %d", &rows, &cols) != 2){
-        fprintf(stderr, "Error reading rows and cols from file\n");
-        fclose(file);
+// Opens fileName and makes its contents available through view->data, returns -1 on failure
+int file_view_open(FileView *view, const char *fileName)
+{
+    int fd = open(fileName, O_RDONLY);
+    if(fd == -1){
+        fprintf(stderr, "Error opening file\n");
         return -1;
     }
 
-    int numOfCells = rows*cols;
+    view->memory = NULL;
+    view->size = 0;
+    view->isMapped = false;
 
-    // Allocates the correct size of predefined struct Map
-    *map = malloc(sizeof(int)*2+sizeof(unsigned char *));
-    if(*map == NULL){
-        fprintf(stderr, "Malloc failed\n");
-        fclose(file);
-        return -1;
+    struct stat fileInfo;
+    if(fstat(fd, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode) && fileInfo.st_size > 0){
+        void *mapping = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED){
+            posix_madvise(mapping, (size_t)fileInfo.st_size, POSIX_MADV_SEQUENTIAL);
+            view->memory = mapping;
+            view->size = (size_t)fileInfo.st_size;
+            view->isMapped = true;
+        }
     }
 
-    (*map)->rows = rows;
-    (*map)->cols = cols;
-
-    // Allocates memory needed for all fields of the matrix
-    (*map)->cells = (unsigned char *) malloc(sizeof(unsigned char) * rows * cols);
-    if((*map)->cells == NULL){
-        fprintf(stderr, "Malloc failed on cells\n");
-        fclose(file);
-        return -1;
-    }
+    // Fallback for files which can't be mapped
+    if(!view->isMapped){
+        size_t capacity = 0;
+        ssize_t readBytes = 0;
+        do {
+            view->size += (size_t)readBytes;
+            if(view->size == capacity){
+                capacity = capacity == 0 ? 65536 : capacity * 2;
+                void *grown = realloc(view->memory, capacity);
+                if(grown == NULL){
+                    fprintf(stderr, "Malloc failed\n");
+                    free(view->memory);
+                    close(fd);
+                    return -1;
+                }
+                view->memory = grown;
+            }
+            readBytes = read(fd, (char *)view->memory + view->size, capacity - view->size);
+        } while(readBytes > 0);
 
-    for(int cellIndex = 0; cellIndex < numOfCells; cellIndex++){
-        unsigned char readValue;
-        if(fscanf(file, "%hhu", &readValue) != 1){ // %hhu - specifier for uchar :O
-            fprintf(stderr, "Error reading row from file\n");
-            fclose(file);
+        if(readBytes == -1){
+            fprintf(stderr, "Error reading file\n");
+            free(view->memory);
+            close(fd);
             return -1;
         }
-        (*map)->cells[cellIndex] = readValue;
     }
-    
-    fclose(file);
+
+    close(fd);
+    view->data = view->memory;
+    view->end = view->data + view->size;
     return 0;
 }
 
-// Destructor for Map structure
-void map_dtor(Map **map) {
-    if (map != NULL && *map != NULL) {
-        free((*map)->cells);
-        free(*map);
-        *map = NULL;
+// Releases the mapping or buffer held by view
+void file_view_close(FileView *view)
+{
+    if(view->isMapped){
+        munmap(view->memory, view->size);
+    } else {
+        free(view->memory);
     }
+    view->memory = NULL;
 }
 
 //
-// Returns a value of a cell at row and column index like an array would
+// Reads a whitespace separated integer and moves the cursor behind it, accepts the same input as fscanf "%d"
+// Returns -1 if there is no integer at the cursor
 //
-int get_cell_value(Map *map, int rowIndex, int columnIndex)
+static inline int scan_int(const char **cursor, const char *end, int *value)
 {
-    // Index meaning 0 - x < rows 
-    if(rowIndex > map->rows || columnIndex > map->cols || rowIndex < 1 || columnIndex < 1){
-        fprintf(stderr, "Error row or column out of bounds\n");
+    const char *pos = *cursor;
+    while(pos < end && (*pos == ' ' || (*pos >= '\t' && *pos <= '\r'))){
+        pos++;
+    }
+
+    bool isNegative = false;
+    if(pos < end && (*pos == '-' || *pos == '+')){
+        isNegative = *pos == '-';
+        pos++;
+    }
+    if(pos == end || *pos < '0' || *pos > '9'){
         return -1;
     }
-    rowIndex--;
-    columnIndex--;
 
-    return (int)map->cells[rowIndex*map->cols + columnIndex];
+    long number = 0;
+    while(pos < end && *pos >= '0' && *pos <= '9'){
+        // Saturates instead of overflowing, such a value is out of bounds anyway
+        if(number <= INT_MAX){
+            number = number * 10 + (*pos - '0');
+        }
+        pos++;
+    }
+    if(number > INT_MAX){
+        number = INT_MAX;
+    }
+
+    *value = isNegative ? -(int)number : (int)number;
+    *cursor = pos;
+    return 0;
+}
+
+// Returns 1 if a number starts at text, 0 if it doesn't and -1 if text is neither a digit nor whitespace, text[-1] has to be readable
+static inline int count_numbers_byte(const char *text)
+{
+    bool isDigit = *text >= '0' && *text <= '9';
+    if(!isDigit && *text != ' ' && (*text < '\t' || *text > '\r')){
+        return -1;
+    }
+    return isDigit && (text[-1] == ' ' || (text[-1] >= '\t' && text[-1] <= '\r'));
 }
 
 //
-// Prints entire already initialized matrix saved inside Map structure
+// Blocks the validators and scan_row work with
+// PlaneBlock holds 512 triangles of a bit plane (see map_validate_planes), RowBlock a triangle per byte of a row
+// (see validator_push_row) and scan_row_block reads half of that many triangles from their text at once
+// With GCC vector extensions they are compiled into AVX-512, AVX2 or SSE2 depending on -march, RowBlock is only as wide
+// as the vector registers because GCC turns comparisons of wider vectors into scalar code
+// Other compilers (or -DMAZE_SCALAR_BLOCKS) fall back to a single 64 bit word, a single byte and a single triangle
 //
-void print_entire_matrix(Map *map)
+#if defined(__GNUC__) && __GNUC__ >= 9 && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(__clang__) && !defined(MAZE_SCALAR_BLOCKS)
+typedef uint64_t PlaneBlock __attribute__((vector_size(PLANE_ALIGNMENT)));
+#define PLANE_BLOCK_WORDS PLANE_ALIGNMENT_WORDS
+#if defined(__AVX512BW__)
+#define ROW_BLOCK_BYTES 64
+#elif defined(__AVX2__)
+#define ROW_BLOCK_BYTES 32
+#else
+#define ROW_BLOCK_BYTES 16
+#endif
+typedef unsigned char RowBlock __attribute__((vector_size(ROW_BLOCK_BYTES)));
+
+//
+// Sets carry to the highest bit of the word in front of every word of current
+// Shifting a whole block left by one bit moves carry in, blocks are passed by pointer to keep the ABI independent of -march
+//
+static inline void plane_block_carry(const PlaneBlock *previous, const PlaneBlock *current, PlaneBlock *carry)
 {
+    const PlaneBlock preceding = {7, 8, 9, 10, 11, 12, 13, 14};
+    *carry = __builtin_shuffle(*previous, *current, preceding) >> 63;
+}
 
-    for(int row = 1; row <= map->rows; row++){
-        for(int column = 1; column <= map->cols; column++){
-            printf(" %d", get_cell_value(map, row, column));
-        }
-        printf("\n");
+// Returns true if any byte of block isn't zero
+static inline bool row_block_any(const RowBlock *block)
+{
+    uint64_t words[ROW_BLOCK_BYTES / sizeof(uint64_t)];
+    memcpy(words, block, sizeof(words));
+    uint64_t any = 0;
+    for(size_t wordIndex = 0; wordIndex < ROW_BLOCK_BYTES / sizeof(uint64_t); wordIndex++){
+        any |= words[wordIndex];
     }
+    return any != 0;
 }
 
+// ROW_BLOCK_BYTES of text as pairs of a digit and the space after it, little endian puts the digit into the low byte
+typedef uint16_t RowTextBlock __attribute__((vector_size(ROW_BLOCK_BYTES)));
+typedef unsigned char RowCellsBlock __attribute__((vector_size(ROW_BLOCK_BYTES / 2)));
+
 //
-// Uses bitwise operations to determine a 0 / 1 state of a bit from a number
+// Reads ROW_BLOCK_BYTES / 2 cells written as single digits followed by a single space from text
+// Returns false without touching cells if the text doesn't look like that, text has to have ROW_BLOCK_BYTES bytes
 //
-bool isolate_bit_value(unsigned eval, BitIndex bit)
+static inline bool scan_row_block(const char *text, unsigned char *cells)
 {
-    unsigned mask = 1U << bit;
-    return eval & mask ? true : false;
+    RowTextBlock pairs;
+    memcpy(&pairs, text, sizeof(pairs));
+    // A digit 0-7 with exactly a space after it becomes a value below 8
+    pairs -= (uint16_t)('0' | ' ' << 8);
+    RowTextBlock outOfBounds = (RowTextBlock)(pairs > 7);
+    uint64_t words[ROW_BLOCK_BYTES / sizeof(uint64_t)];
+    memcpy(words, &outOfBounds, sizeof(words));
+    uint64_t any = 0;
+    for(size_t wordIndex = 0; wordIndex < ROW_BLOCK_BYTES / sizeof(uint64_t); wordIndex++){
+        any |= words[wordIndex];
+    }
+    if(any != 0){
+        return false;
+    }
+    RowCellsBlock values = __builtin_convertvector(pairs, RowCellsBlock);
+    memcpy(cells, &values, sizeof(values));
+    return true;
 }
 
 //
-// Determines if a border is present in a certain Direction 
+// Vector version of count_numbers_byte for all whole RowBlocks of text from *text to end, moves *text past them
+// Returns the number of numbers starting inside the blocks or -1
 //
-bool isborder(Map *map, int r, int c, int border)
+static inline long long count_numbers_blocks(const char **text, const char *end)
 {
-    
-    int cell = get_cell_value(map, r, c);
-    if(cell == -1){
-        fprintf(stderr, "Error cell [%d] isn't valid\n", cell);
+    const char *pos = *text;
+    long long numbers = 0;
+    RowBlock other = {0};
+    while(end - pos >= ROW_BLOCK_BYTES){
+        // Every byte counts the starts at its position, it would overflow after 255 blocks
+        RowBlock starts = {0};
+        for(int blockIndex = 0; blockIndex < 255 && end - pos >= ROW_BLOCK_BYTES; blockIndex++, pos += ROW_BLOCK_BYTES){
+            RowBlock current, previous;
+            memcpy(&current, pos, sizeof(current));
+            memcpy(&previous, pos - 1, sizeof(previous));
+            RowBlock digit = (RowBlock)((RowBlock)(current - '0') < 10);
+            RowBlock space = (RowBlock)(((RowBlock)(current - ' ') < 1) | ((RowBlock)(current - '\t') < 5));
+            RowBlock previousSpace = (RowBlock)(((RowBlock)(previous - ' ') < 1) | ((RowBlock)(previous - '\t') < 5));
+            other |= ~(digit | space);
+            // Comparisons give 0xFF for true
+            starts -= digit & previousSpace;
+        }
+        unsigned char counts[ROW_BLOCK_BYTES];
+        memcpy(counts, &starts, sizeof(counts));
+        for(int index = 0; index < ROW_BLOCK_BYTES; index++){
+            numbers += counts[index];
+        }
     }
-    unsigned cellValue = (unsigned) cell;
-    
-    switch(border){
-        case L:
-            return isolate_bit_value(cellValue, LEFT_BIT);
-        break;
-        case R:
-            return isolate_bit_value(cellValue, RIGHT_BIT);
-        break;
-        case U:
-            return isolate_bit_value(cellValue, UPDOWN_BIT);
-        case D:
-            return isolate_bit_value(cellValue, UPDOWN_BIT);
-        break;
+    *text = pos;
+    return row_block_any(&other) ? -1 : numbers;
+}
+#else
+typedef uint64_t PlaneBlock;
+#define PLANE_BLOCK_WORDS 1
+typedef unsigned char RowBlock;
+#define ROW_BLOCK_BYTES 1
 
-        default:
-            fprintf(stderr, "Error direction %d doesn't exist\n", border);
+static inline bool row_block_any(const RowBlock *block)
+{
+    return *block != 0;
+}
 
-    }
+static inline void plane_block_carry(const PlaneBlock *previous, const PlaneBlock *current, PlaneBlock *carry)
+{
+    (void)current;
+    *carry = *previous >> 63;
+}
 
-    // To avoid warnings
-    fprintf(stderr, "Error border could not be determined\n");
+// Scalar version of scan_row_block above, a cell needs two bytes of text
+static inline bool scan_row_block(const char *text, unsigned char *cells)
+{
+    if(text[0] < '0' || text[0] > '7' || text[1] != ' '){
+        return false;
+    }
+    cells[0] = (unsigned char)(text[0] - '0');
     return true;
 }
 
+// Scalar version leaves all of the text to count_numbers_byte
+static inline long long count_numbers_blocks(const char **text, const char *end)
+{
+    (void)text;
+    (void)end;
+    return 0;
+}
+#endif
+
+// Text of a row parsed by a single scan_row_block, digits and spaces of ROW_BLOCK_CELLS cells
+#define ROW_BLOCK_TEXT (ROW_BLOCK_BYTES > 1 ? ROW_BLOCK_BYTES : 2)
+#define ROW_BLOCK_CELLS (ROW_BLOCK_TEXT / 2)
+
+// Returns the number of RowBlocks covering a row of cols cells
+static inline size_t row_blocks(int cols)
+{
+    return ((size_t)cols + ROW_BLOCK_BYTES - 1) / ROW_BLOCK_BYTES;
+}
+
+// Size of a row buffer for scan_row and validator_push_row, a byte in front of column 1 and zeroed padding after the last RowBlock
+static inline size_t row_buffer_size(int cols)
+{
+    return 1 + row_blocks(cols) * ROW_BLOCK_BYTES + 1;
+}
 
 //
-// Returns a value of TriangleType
+// Validates a maze one row at a time in the order the rows are read
+// Keeps only the previous row, memory used doesn't depend on the number of rows
 //
-int determine_triangle_type(Position pos)
+typedef struct {
+    int cols;
+    int row; // Number of the next pushed row
+    bool hasAbove; // False until the first row is pushed, row doesn't have to start at 1
+    unsigned char *window; // Previous row, padded to whole RowBlocks
+    unsigned char *checkerboard; // UPDOWN_BIT in every even byte, see validator_push_row
+    MazeValidity validity;
+    int invalidRow; // Position of the first inconsistency, only set when validity != MAZE_VALID
+    int invalidCol;
+} Validator;
+
+// Initializes a Validator for a maze with cols columns
+int validator_ctor(Validator *validator, int cols)
 {
-    if(pos.r < 1 || pos.c < 1){
-        fprintf(stderr, "Error triangle type couldn't be determined pos.r or pos.c are out of bounds\n");
+    size_t windowSize = row_blocks(cols) * ROW_BLOCK_BYTES;
+    validator->window = calloc(windowSize, sizeof(unsigned char));
+    validator->checkerboard = malloc(windowSize + 1);
+    if(validator->window == NULL || validator->checkerboard == NULL){
+        fprintf(stderr, "Malloc failed on validator\n");
+        free(validator->window);
+        free(validator->checkerboard);
         return -1;
     }
-
-    // Even Row
-    if(pos.r % 2 == 0){
-        if(pos.c % 2 == 1)
-            return CONTAINS_DOWN; // Has a DOWN border
-        else
-            return CONTAINS_UP; // Has an UP border
+    for(size_t index = 0; index <= windowSize; index++){
+        validator->checkerboard[index] = index % 2 == 0 ? 1U << UPDOWN_BIT : 0;
     }
+    validator->cols = cols;
+    validator->row = 1;
+    validator->hasAbove = false;
+    validator->validity = MAZE_VALID;
+    return 0;
+}
 
-    // Odd Row
-    if(pos.r % 2 == 1){
-        if(pos.c % 2 == 0)
-            return CONTAINS_DOWN; // Has a DOWN border
-        else
-            return CONTAINS_UP; // Has an UP border
-    }
-        
-    fprintf(stderr, "Error triangle type couldn't be determined pos.r or pos.c are out of bounds\n");
-    return -1;
+// Destructor for Validator structure
+void validator_dtor(Validator *validator)
+{
+    free(validator->window);
+    free(validator->checkerboard);
+    validator->window = NULL;
+    validator->checkerboard = NULL;
 }
 
 //
-// Sets the maze boundary of an triangle returns a DEC value of 0-7
+// Checks a row that follows the previously pushed one, a RowBlock of triangles at a time
+// row has to point one byte into a buffer of row_buffer_size, the bytes around the cells are overwritten
 //
-int determine_maze_boundary(Map *map, Triangle triangle)
+static inline void validator_push_row(Validator *validator, unsigned char *row)
 {
-    unsigned mazeBoundary = 0;
-    int r = triangle.pos.r, c = triangle.pos.c;
-    if(r < 1 || c < 1){
-        fprintf(stderr, "Error couldn't read position of triangle\n");
-        return -1;
-    }
+    int cols = validator->cols;
+    size_t blocks = row_blocks(cols);
 
-    if(r == 1 && triangle.type == CONTAINS_UP){
-        mazeBoundary += pow(2, UPDOWN_BIT);     // Adds correct DEC value corresponding to the bit
-    } else if(r == map->rows && triangle.type == CONTAINS_DOWN){
-        mazeBoundary += pow(2, UPDOWN_BIT);
-    }
+    if(validator->validity == MAZE_VALID){
+        // Column 1 has no left neighbour and the byte after the last column isn't a triangle, both get borders that always agree
+        row[-1] = (unsigned char)(isolate_bit_value(row[0], LEFT_BIT) << RIGHT_BIT);
+        row[cols] = (unsigned char)(isolate_bit_value(row[cols-1], RIGHT_BIT) << LEFT_BIT);
+        // Triangles sharing an UP/DOWN border, the lower one has r + c even (see determine_triangle_type)
+        const unsigned char *shared = validator->checkerboard + (validator->row % 2 == 1 ? 0 : 1);
 
-    if(c == 1){
-        mazeBoundary += pow(2, LEFT_BIT);
-    } else if(c == map->cols){
-        mazeBoundary += pow(2, RIGHT_BIT);
+        for(size_t block = 0; block < blocks; block++){
+            size_t offset = block * ROW_BLOCK_BYTES;
+            RowBlock current, previous, above, sharedMask;
+            memcpy(&current, row + offset, sizeof(RowBlock));
+            memcpy(&previous, row + offset - 1, sizeof(RowBlock));
+            memcpy(&above, validator->window + offset, sizeof(RowBlock));
+            memcpy(&sharedMask, shared + offset, sizeof(RowBlock));
+
+            // Right border of the previous triangle has to match the left border of this one
+            RowBlock mismatch = ((previous >> RIGHT_BIT) ^ current) & (1U << LEFT_BIT);
+            if(validator->hasAbove){
+                mismatch |= (current ^ above) & sharedMask;
+            }
+            if(!row_block_any(&mismatch)){
+                continue;
+            }
+
+            unsigned char bytes[ROW_BLOCK_BYTES];
+            memcpy(bytes, &mismatch, sizeof(bytes));
+            int col = 0;
+            while(bytes[col] == 0){
+                col++;
+            }
+            validator->validity = MAZE_WRONG_BORDERS;
+            validator->invalidRow = validator->row;
+            validator->invalidCol = (int)offset + col + 1;
+            break;
+        }
     }
-    
-    return mazeBoundary;
+
+    memcpy(validator->window, row, blocks * ROW_BLOCK_BYTES);
+    validator->row++;
+    validator->hasAbove = true;
 }
 
-// Initializes a triangle structure
-int initialize_triangle(Map *map, Triangle *triangle, int r, int c)
+// Most triangles of a maze walked by --rpath and --lpath with --storage tiles, indexes of its tiles still fit into int
+#define TILED_CELL_LIMIT (1LL << 40)
+
+// Most triangles a maze may have, main raises it to TILED_CELL_LIMIT for walks on tiles which use 64 bit cell indexes
+long long cellLimit = INT_MAX;
+
+// Reads rows and cols at the start of a maze file
+int scan_header(const char **cursor, const char *end, int *rows, int *cols)
 {
-    if(r < 1 || c < 1){
-        fprintf(stderr, "Error initializing triangle\n");
+    if(scan_int(cursor, end, rows) == -1 || scan_int(cursor, end, cols) == -1){
+        error_print("Error reading rows and cols from file\n");
+        return -1;
+    }
+
+    if(*rows < 1 || *cols < 1 || (long long)*rows * *cols > TILED_CELL_LIMIT){
+        error_print("Error wrong matrix dimensions\n");
+        return -1;
+    }
+    if((long long)*rows * *cols > cellLimit){
+        error_print("Error mazes of more than %d triangles are only walked by --rpath and --lpath with --storage tiles\n", INT_MAX);
         return -1;
     }
-    // Initializes all necesarry values
-    triangle->pos.r = r;
-    triangle->pos.c = c;
-    triangle->type = determine_triangle_type(triangle->pos);
-    triangle->borderValue = get_cell_value(map, r, c);
-    triangle->mazeBoundary = determine_maze_boundary(map, *triangle);
     return 0;
 }
 
-// Checks if a side in direction is a boundary of the maze using triangle.mazeBoundary values defined in determine_maze_boundary
-bool is_maze_boundary(Triangle triangle, Direction checkDirection)
+// Prints the position of the first inconsistent border found by a Validator or map_validate_planes
+void print_wrong_borders(int row, int col)
 {
-    
-    unsigned mazeBoundary = triangle.mazeBoundary;
-    
-    switch(checkDirection){
-        case L:
-            return isolate_bit_value(mazeBoundary, LEFT_BIT);
-        break;
-        case R:
-            return isolate_bit_value(mazeBoundary, RIGHT_BIT);
-        break;
-        case U:
-            return isolate_bit_value(mazeBoundary, UPDOWN_BIT);
-        case D:
-            return isolate_bit_value(mazeBoundary, UPDOWN_BIT);
-            break;
-        default:
-            fprintf(stderr, "Error direction %d doesn't exist\n", checkDirection);
-
-    }
-
-    // To avoid warnings
-    fprintf(stderr, "Error triangle boundary could not be determined\n");
-    return false;
+    error_print("Error borders aren't defined correctly at %d,%d\n", row, col);
 }
 
-// Uses [Direction] as a means of changing the r and c values
-const Position directionVector[4] = {
-    {0, -1},    // move LEFT
-    {0, 1},     // move RIGHT
-    {-1, 0},    // move UP
-    {1, 0},     // move DOWN
-};
+// Returns row r of the plane of bit inside Map.planes
+static inline uint64_t *map_plane_row(Map *map, BitIndex bit, int r)
+{
+    return map->planes + ((size_t)bit * map->rows + (r-1)) * map->planeStride;
+}
 
-// Returns a value signifying whether a resultingTriangle has been moved and set in a chosen direction correctly
-/* 
- *   -1 = ERROR
- *    0 = SUCCESS
- *    1 = triangle would've moved outside maze
-*/
-int triangle_move_in(Map *map, Triangle triangleToMove, Triangle *resultingTriangle, Direction direction)
+// Stores borders of a freshly read row r into map, planes have to start zeroed
+static inline void map_store_row(Map *map, int r, const unsigned char *cells)
 {
-    // Checks if a triangle even has a side to move to 
-    if(direction > D || direction < L){
-        fprintf(stderr, "Error direction value doesn't exist\n");
-        return -2;
+    if(map->storage == MAP_STORAGE_BYTES){
+        memcpy(map->cells + (size_t)(r-1) * map->cols, cells, map->cols);
+        return;
     }
-    if(triangleToMove.type == CONTAINS_UP && direction == D){
-        fprintf(stderr, "Error cannot move in that direction wrong TriangleType\n");
-        return -2;
+    for(BitIndex bit = LEFT_BIT; bit <= UPDOWN_BIT; bit++){
+        uint64_t *planeRow = map_plane_row(map, bit, r);
+        for(int c = 1; c <= map->cols; c++){
+            planeRow[(c-1) / 64] |= (uint64_t)isolate_bit_value(cells[c-1], bit) << ((c-1) % 64);
+        }
+    }
+}
+
+// Result of scan_row
+typedef enum {
+    ROW_OUT_OF_BOUNDS = -2, // A cell isn't in 0-7
+    ROW_MISSING_CELL = -1, // A cell isn't a number or the file ends
+    ROW_READ = 0,
+} RowResult;
+
+// Prints the error of a RowResult returned by scan_row for row, value is the cell out of bounds
+void print_row_error(int result, int row, int value)
+{
+    if(result == ROW_MISSING_CELL){
+        error_print("Error reading row from file\n");
+    } else if(result == ROW_OUT_OF_BOUNDS){
+        error_print("Error row %d from file is out of bounds: [%d] != (0-7)\n", row, value);
+    }
+}
+
+//
+// Reads a row of cols cells into cells, returns a RowResult and sets value to the cell that is out of bounds
+// Rows written as single digits separated by single spaces are read a RowBlock at a time, anything else by scan_int
+//
+static inline int scan_row(const char **cursor, const char *end, int cols, unsigned char *cells, int *value)
+{
+    const char *pos = *cursor;
+    while(pos < end && (*pos == ' ' || (*pos >= '\t' && *pos <= '\r'))){
+        pos++;
+    }
+    const char *rowStart = pos;
+
+    int col = 0;
+    while(cols - col > ROW_BLOCK_CELLS && end - pos >= ROW_BLOCK_TEXT && scan_row_block(pos, cells + col)){
+        col += ROW_BLOCK_CELLS;
+        pos += ROW_BLOCK_TEXT;
+    }
+    // Rest of the row, the last cell only has to be followed by something else than a digit
+    for(; col < cols; col++){
+        if(pos == end || *pos < '0' || *pos > '7'){
+            break;
+        }
+        bool last = col == cols - 1;
+        bool separated = last ? pos + 1 == end || pos[1] < '0' || pos[1] > '9' : pos + 1 < end && pos[1] == ' ';
+        if(!separated){
+            break;
+        }
+        cells[col] = (unsigned char)(*pos - '0');
+        pos += last ? 1 : 2;
+    }
+    if(col == cols){
+        *cursor = pos;
+        return ROW_READ;
+    }
+
+    pos = rowStart;
+    for(col = 0; col < cols; col++){
+        if(scan_int(&pos, end, value) == -1){
+            return ROW_MISSING_CELL;
+        }
+
+        // Check if an element is in bounds of 3 bits
+        if(*value < 0 || *value > 7){
+            return ROW_OUT_OF_BOUNDS;
+        }
+        cells[col] = (unsigned char)*value;
+    }
+    *cursor = pos;
+    return ROW_READ;
+}
+
+//
+// Reads rows*cols cells following the header and pushes them into validator unless it's NULL
+// Cells are also stored into map unless it's NULL, returns -1 if a cell is missing or out of bounds
+// cells has to point one byte into a zeroed buffer of row_buffer_size(cols), every row is read into it
+//
+int scan_rows(const char **cursor, const char *end, int rows, int cols, unsigned char *cells, Validator *validator, Map *map)
+{
+    const char *start = *cursor;
+    int result = ROW_READ;
+    int row = 1;
+    for(; row <= rows && result == ROW_READ; row++){
+        int value;
+        result = scan_row(cursor, end, cols, cells, &value);
+        if(result != ROW_READ){
+            print_row_error(result, row, value);
+            break;
+        }
+        if(validator != NULL){
+            validator_push_row(validator, cells);
+        }
+        if(map != NULL){
+            map_store_row(map, row, cells);
+        }
+    }
+    STATS_ADD(bytesParsed, *cursor - start);
+    if(validator != NULL){
+        STATS_ADD(cellsValidated, (long long)(row - 1) * cols);
+    }
+
+    if(result != ROW_READ){
+        return -1;
+    }
+    if(validator != NULL && validator->validity == MAZE_WRONG_BORDERS){
+        print_wrong_borders(validator->invalidRow, validator->invalidCol);
+    }
+    return 0;
+}
+
+// Same as scan_rows with a row buffer of its own
+int scan_cells(const char **cursor, const char *end, int rows, int cols, Validator *validator, Map *map)
+{
+    unsigned char *buffer = calloc(row_buffer_size(cols), sizeof(unsigned char));
+    if(buffer == NULL){
+        fprintf(stderr, "Malloc failed on row\n");
+        return -1;
+    }
+    int result = scan_rows(cursor, end, rows, cols, buffer + 1, validator, map);
+    free(buffer);
+    return result;
+}
+
+//
+// Packs orientation and maze boundary of a triangle into the bits above its borders
+// Map.cells keeps the packed value of every triangle, so moving through the maze doesn't need to compute them again
+//
+static inline unsigned pack_cell(unsigned borders, int r, int c, int rows, int cols)
+{
+    unsigned packed = borders & BORDER_MASK;
+    // Same rule as determine_triangle_type
+    bool containsDown = (r + c) % 2 == 1;
+    if(containsDown){
+        packed |= 1U << ORIENTATION_BIT;
+    }
+    if(c == 1){
+        packed |= 1U << (BOUNDARY_SHIFT + LEFT_BIT);
+    }
+    if(c == cols){
+        packed |= 1U << (BOUNDARY_SHIFT + RIGHT_BIT);
+    }
+    if((r == 1 && !containsDown) || (r == rows && containsDown)){
+        packed |= 1U << (BOUNDARY_SHIFT + UPDOWN_BIT);
+    }
+    return packed;
+}
+
+// Packs every triangle of a MAP_STORAGE_BYTES map
+void map_pack_cells(Map *map)
+{
+    unsigned char *cells = map->cells;
+    for(int r = 1; r <= map->rows; r++){
+        for(int c = 1; c <= map->cols; c++, cells++){
+            *cells = (unsigned char)pack_cell(*cells, r, c, map->rows, map->cols);
+        }
+    }
+}
+
+//
+// Rows and columns of a tile of MAP_STORAGE_TILES, a tile keeps TILE_SIDE * TILE_SIDE packed cells
+#define TILE_SIDE 256
+#define TILE_CELLS (TILE_SIDE * TILE_SIDE)
+// Marks an unused slot of a TileCache and a tile which isn't in any slot
+#define NO_TILE -1
+
+// Where a TileCache reads its tiles from
+typedef enum {
+    TILE_SOURCE_TEXT, // Rows are parsed again on every load, TileCache.rowOffsets point at their first cell
+    TILE_SOURCE_COMPILED, // Packed cells of a compiled maze starting at TileCache.cellsOffset
+} TileSource;
+
+//
+// Tiles of a MAP_STORAGE_TILES map kept in a fixed number of slots, the least recently used tile is replaced first
+// The maze file stays open and tiles are read with pread on demand, so only slots and per row offsets take up memory
+//
+typedef struct TileCache {
+    int rows;
+    int cols;
+    int tilesAcross;
+    int tileCount;
+    int fd;
+    TileSource source;
+    off_t cellsOffset; // TILE_SOURCE_COMPILED only
+    int64_t *rowOffsets; // TILE_SOURCE_TEXT only, rows+1 offsets, the last one is behind the last cell
+    bool *rowIsRegular; // TILE_SOURCE_TEXT only, row has single digits separated by single spaces
+    bool isCopy; // Made by tile_cache_copy, rowOffsets and rowIsRegular belong to the cache it was copied from
+    char *text; // Read buffer for a row, textSize bytes
+    size_t textSize;
+    unsigned char *rowCells; // Cells of a row which isn't regular, row_buffer_size(cols) bytes
+    int shareCount; // Caches of the same maze splitting tileBudget, one for every worker searching it
+    int slotCount;
+    int usedSlots;
+    unsigned char *cells; // slotCount * TILE_CELLS packed cells
+    int *tileOfSlot;
+    int *slotOfTile; // Every tile of the maze, NO_TILE unless it's loaded
+    int *newer; // Doubly linked list of slots from the most to the least recently used
+    int *older;
+    int newest;
+    int oldest;
+    int lastTile; // Tile of the previous lookup, skips the list for the usual run of moves inside one tile
+    const unsigned char *lastCells;
+    long long loads;
+} TileCache;
+
+// Reads size bytes at offset, returns false if the file ended or couldn't be read
+bool tile_cache_read(TileCache *cache, void *data, size_t size, off_t offset)
+{
+    char *pos = data;
+    while(size > 0){
+        ssize_t readBytes = pread(cache->fd, pos, size, offset);
+        if(readBytes <= 0){
+            return false;
+        }
+        pos += readBytes;
+        size -= (size_t)readBytes;
+        offset += readBytes;
+    }
+    return true;
+}
+
+// Reads count cells of row r starting at column c into cells as packed values, returns false on failure
+bool tile_cache_read_row(TileCache *cache, int r, int c, int count, unsigned char *cells)
+{
+    if(cache->source == TILE_SOURCE_COMPILED){
+        return tile_cache_read(cache, cells, (size_t)count, cache->cellsOffset + (off_t)(r-1) * cache->cols + (c-1));
+    }
+
+    // Regular rows keep cell c at a fixed offset, anything else is parsed from the start of the row
+    if(cache->rowIsRegular[r-1]){
+        if(!tile_cache_read(cache, cache->text, (size_t)count * 2 - 1, (off_t)cache->rowOffsets[r-1] + (off_t)(c-1) * 2)){
+            return false;
+        }
+        for(int col = 0; col < count; col++){
+            cells[col] = (unsigned char)(cache->text[col * 2] - '0');
+        }
+    } else {
+        size_t size = (size_t)(cache->rowOffsets[r] - cache->rowOffsets[r-1]);
+        const char *cursor = cache->text;
+        int value;
+        if(!tile_cache_read(cache, cache->text, size, (off_t)cache->rowOffsets[r-1])
+           || scan_row(&cursor, cache->text + size, cache->cols, cache->rowCells, &value) != ROW_READ){
+            return false;
+        }
+        memcpy(cells, cache->rowCells + (c-1), (size_t)count);
+    }
+    for(int col = 0; col < count; col++){
+        cells[col] = (unsigned char)pack_cell(cells[col], r, c + col, cache->rows, cache->cols);
+    }
+    return true;
+}
+
+// Moves slot to the front of the list of recently used slots
+static inline void tile_cache_touch(TileCache *cache, int slot)
+{
+    if(cache->newest == slot){
+        return;
+    }
+    // Unlinks the slot, it isn't the newest so there is a newer one
+    int newer = cache->newer[slot];
+    int older = cache->older[slot];
+    cache->older[newer] = older;
+    if(older != NO_TILE){
+        cache->newer[older] = newer;
+    } else {
+        cache->oldest = newer;
+    }
+
+    cache->newer[slot] = NO_TILE;
+    cache->older[slot] = cache->newest;
+    cache->newer[cache->newest] = slot;
+    cache->newest = slot;
+}
+
+//
+// Makes tile the current tile of cache, loads it into a free slot or into the least recently used one
+// A tile which can't be read is filled with closed triangles, so a path running into it stops with an error
+//
+void tile_cache_fetch(TileCache *cache, int tile)
+{
+    int slot = cache->slotOfTile[tile];
+    if(slot != NO_TILE){
+        tile_cache_touch(cache, slot);
+    } else {
+        if(cache->usedSlots < cache->slotCount){
+            slot = cache->usedSlots++;
+            cache->newer[slot] = NO_TILE;
+            cache->older[slot] = cache->newest;
+            if(cache->newest != NO_TILE){
+                cache->newer[cache->newest] = slot;
+            } else {
+                cache->oldest = slot;
+            }
+            cache->newest = slot;
+        } else {
+            slot = cache->oldest;
+            cache->slotOfTile[cache->tileOfSlot[slot]] = NO_TILE;
+            tile_cache_touch(cache, slot);
+        }
+        cache->tileOfSlot[slot] = tile;
+        cache->slotOfTile[tile] = slot;
+        cache->loads++;
+
+        unsigned char *cells = cache->cells + (size_t)slot * TILE_CELLS;
+        int firstRow = tile / cache->tilesAcross * TILE_SIDE + 1;
+        int firstCol = tile % cache->tilesAcross * TILE_SIDE + 1;
+        int width = cache->cols - firstCol + 1 < TILE_SIDE ? cache->cols - firstCol + 1 : TILE_SIDE;
+        for(int r = firstRow; r < firstRow + TILE_SIDE && r <= cache->rows; r++){
+            unsigned char *row = cells + (size_t)(r - firstRow) * TILE_SIDE;
+            if(!tile_cache_read_row(cache, r, firstCol, width, row)){
+                fprintf(stderr, "Error reading row %d of the maze\n", r);
+                memset(row, BORDER_MASK, (size_t)width);
+            }
+        }
+    }
+    cache->lastTile = tile;
+    cache->lastCells = cache->cells + (size_t)slot * TILE_CELLS;
+}
+
+// Returns the packed value of a triangle of a MAP_STORAGE_TILES map, loads its tile when needed
+static inline unsigned tile_cache_cell(TileCache *cache, int r, int c)
+{
+    int tile = (r-1) / TILE_SIDE * cache->tilesAcross + (c-1) / TILE_SIDE;
+    if(tile != cache->lastTile){
+        tile_cache_fetch(cache, tile);
+    }
+    return cache->lastCells[(r-1) % TILE_SIDE * TILE_SIDE + (c-1) % TILE_SIDE];
+}
+
+// Returns the packed value of a triangle whichever MapStorage map uses, cellIndex has to match r and c
+// MAP_STORAGE_PLANES packs the value on every call, planes have no spare bits to keep it in
+//
+static inline unsigned map_packed_cell(Map *map, int r, int c, int64_t cellIndex)
+{
+    if(map->storage == MAP_STORAGE_BYTES){
+        return map->cells[cellIndex];
+    }
+    if(map->storage == MAP_STORAGE_TILES){
+        return tile_cache_cell(map->tiles, r, c);
+    }
+    size_t word = (size_t)(c-1) / 64;
+    unsigned bit = (unsigned)(c-1) % 64;
+    unsigned borders = (unsigned)(map_plane_row(map, LEFT_BIT, r)[word] >> bit & 1) << LEFT_BIT
+                     | (unsigned)(map_plane_row(map, RIGHT_BIT, r)[word] >> bit & 1) << RIGHT_BIT
+                     | (unsigned)(map_plane_row(map, UPDOWN_BIT, r)[word] >> bit & 1) << UPDOWN_BIT;
+    return pack_cell(borders, r, c, map->rows, map->cols);
+}
+
+// Sets block to the lowest count bits of a plane row, block starts at the word first of the row
+static inline void plane_block_low_bits(PlaneBlock *block, size_t first, long long count)
+{
+    uint64_t words[PLANE_BLOCK_WORDS];
+    for(size_t wordIndex = 0; wordIndex < PLANE_BLOCK_WORDS; wordIndex++){
+        long long bits = count - (long long)(first + wordIndex) * 64;
+        words[wordIndex] = bits >= 64 ? UINT64_MAX : bits <= 0 ? 0 : (1ULL << bits) - 1;
+    }
+    memcpy(block, words, sizeof(*block));
+}
+
+//
+// Validates the borders of a MAP_STORAGE_PLANES map a PlaneBlock at a time, same rules as validator_push
+// Right plane moved by one triangle has to equal the left plane, vertical planes of neighbouring rows
+// have to be equal for every triangle with r + c even
+// Returns 0 for a valid maze, otherwise -1 and the first inconsistent triangle in the order of the file
+//
+int map_validate_planes(Map *map, int *invalidRow, int *invalidCol)
+{
+    // Blocks holding at least one column, the rest of a row is zeroed padding
+    size_t blocks = ((size_t)map->cols + PLANE_BLOCK_WORDS * 64 - 1) / (PLANE_BLOCK_WORDS * 64);
+    // Column 1 has no left neighbour, padding after the last column only ever differs by the bit moved into it
+    PlaneBlock firstMask, lastMask;
+    plane_block_low_bits(&firstMask, 0, 1);
+    firstMask = ~firstMask;
+    plane_block_low_bits(&lastMask, (blocks - 1) * PLANE_BLOCK_WORDS, map->cols);
+
+    for(int r = 1; r <= map->rows; r++){
+        const PlaneBlock *left = (const PlaneBlock *)map_plane_row(map, LEFT_BIT, r);
+        const PlaneBlock *right = (const PlaneBlock *)map_plane_row(map, RIGHT_BIT, r);
+        const PlaneBlock *vertical = (const PlaneBlock *)map_plane_row(map, UPDOWN_BIT, r);
+        const PlaneBlock *above = r > 1 ? (const PlaneBlock *)map_plane_row(map, UPDOWN_BIT, r - 1) : NULL;
+        // Bit i of a word is column i + 1, so r + c is even on the even bits of odd rows and the odd bits of even rows
+        uint64_t sharedWithAbove = r % 2 == 1 ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;
+
+        PlaneBlock previousRight = {0};
+        for(size_t block = 0; block < blocks; block++){
+            PlaneBlock carry;
+            plane_block_carry(&previousRight, &right[block], &carry);
+            PlaneBlock mismatch = (right[block] << 1 | carry) ^ left[block];
+            if(block == 0){
+                mismatch &= firstMask;
+            }
+            if(block == blocks - 1){
+                mismatch &= lastMask;
+            }
+            if(above != NULL){
+                mismatch |= (vertical[block] ^ above[block]) & sharedWithAbove;
+            }
+            previousRight = right[block];
+
+            uint64_t words[PLANE_BLOCK_WORDS];
+            memcpy(words, &mismatch, sizeof(words));
+            for(size_t wordIndex = 0; wordIndex < PLANE_BLOCK_WORDS; wordIndex++){
+                if(words[wordIndex] == 0){
+                    continue;
+                }
+                int bit = 0;
+                while(!(words[wordIndex] >> bit & 1)){
+                    bit++;
+                }
+                *invalidRow = r;
+                *invalidCol = (int)((block * PLANE_BLOCK_WORDS + wordIndex) * 64) + bit + 1;
+                STATS_ADD(cellsValidated, (long long)r * map->cols);
+                return -1;
+            }
+        }
+    }
+    STATS_ADD(cellsValidated, (long long)map->rows * map->cols);
+    return 0;
+}
+
+// Set by --storage, MapStorage used by map_ctor
+MapStorage mapStorage = MAP_STORAGE_BYTES;
+
+// Allocates zeroed storage of the kind map->storage for map->rows * map->cols triangles, returns -1 on failure
+int map_alloc_storage(Map *map)
+{
+    map->cells = NULL;
+    map->planes = NULL;
+    map->planeStride = 0;
+    if(map->storage == MAP_STORAGE_BYTES){
+        map->cells = (unsigned char *) malloc(sizeof(unsigned char) * map->rows * map->cols);
+        if(map->cells == NULL){
+            fprintf(stderr, "Malloc failed on cells\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    map->planeStride = ((size_t)map->cols + PLANE_ALIGNMENT * 8 - 1) / (PLANE_ALIGNMENT * 8) * PLANE_ALIGNMENT_WORDS;
+    size_t planeBytes = sizeof(uint64_t) * map->planeStride * map->rows * NUM_OF_SIDES;
+    map->planes = aligned_alloc(PLANE_ALIGNMENT, planeBytes);
+    if(map->planes == NULL){
+        fprintf(stderr, "Malloc failed on planes\n");
+        return -1;
+    }
+    memset(map->planes, 0, planeBytes);
+    return 0;
+}
+
+// Magic at the start of a compiled maze written by --compile, its format version and byte order mark
+#define TMAZE_MAGIC "TMAZEBIN"
+#define TMAZE_VERSION 2
+#define TMAZE_BYTE_ORDER 0x01020304U
+// Alignment of every section inside a compiled maze, so that its arrays can be used straight from the mapping
+#define TMAZE_ALIGNMENT 64
+// Set in TmazeHeader.flags when the borders of the maze are consistent
+#define TMAZE_FLAG_VALID 0x01
+
+// Kinds of sections of a compiled maze, only TMAZE_SECTION_CELLS is always present
+typedef enum {
+    TMAZE_SECTION_CELLS = 1, // rows*cols packed cells, same as Map.cells
+    TMAZE_SECTION_COMPONENTS, // uint32_t componentCount, uint32_t padding, labels and ComponentInfo like a components sidecar
+    TMAZE_SECTION_GRAPH, // rows*cols*NUM_OF_SIDES int32_t links, same as Graph.links
+} TmazeSectionKind;
+
+// Entry of the section table following TmazeHeader
+typedef struct {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset; // From the start of the file
+    uint64_t size;
+} TmazeSection;
+
+//
+// Start of a compiled maze, everything is in the byte order of the machine that compiled it
+// Validation is done once by --compile, flags and the first inconsistent triangle are kept here
+//
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t flags;
+    uint32_t invalidRow; // Position of the first inconsistency, only set without TMAZE_FLAG_VALID
+    uint32_t invalidCol;
+    uint32_t sectionCount;
+    uint64_t checksum; // tmaze_checksum of the cells section
+} TmazeHeader;
+
+// Returns true if view holds a compiled maze instead of a text one
+bool tmaze_is(const FileView *view)
+{
+    return view->size >= sizeof(TmazeHeader) && memcmp(view->data, TMAZE_MAGIC, 8) == 0;
+}
+
+// Returns the header of a compiled maze, NULL with a message if it's broken or of another version
+const TmazeHeader *tmaze_header(const FileView *view)
+{
+    const TmazeHeader *header = (const TmazeHeader *)view->data;
+    if(header->version != TMAZE_VERSION || header->byteOrder != TMAZE_BYTE_ORDER){
+        error_print("Error compiled maze has an unsupported version or byte order\n");
+        return NULL;
+    }
+    if(view->size < sizeof(TmazeHeader) + (uint64_t)header->sectionCount * sizeof(TmazeSection)
+       || header->rows < 1 || header->cols < 1 || header->rows > INT_MAX || header->cols > INT_MAX
+       || (long long)header->rows * header->cols > cellLimit){
+        error_print("Error compiled maze is damaged\n");
+        return NULL;
+    }
+    return header;
+}
+
+// Returns the section of kind inside a compiled maze with a checked header, NULL if it's missing or out of the file
+const TmazeSection *tmaze_section(const FileView *view, TmazeSectionKind kind)
+{
+    const TmazeHeader *header = (const TmazeHeader *)view->data;
+    const TmazeSection *sections = (const TmazeSection *)(view->data + sizeof(TmazeHeader));
+    for(uint32_t sectionIndex = 0; sectionIndex < header->sectionCount; sectionIndex++){
+        const TmazeSection *section = &sections[sectionIndex];
+        if(section->kind == kind && section->offset % TMAZE_ALIGNMENT == 0
+           && section->offset <= view->size && section->size <= view->size - section->offset){
+            return section;
+        }
+    }
+    return NULL;
+}
+
+// Hash of the cells of a compiled maze, catches damaged files but isn't checked by modes that just load the maze
+uint64_t tmaze_checksum(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t offset = 0;
+    for(; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)){
+        uint64_t word;
+        memcpy(&word, data + offset, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 32;
+    }
+    for(; offset < size; offset++){
+        hash = (hash ^ data[offset]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Set by --memory-budget, MiB a MAP_STORAGE_TILES map keeps in memory
+// Half of it holds tiles, the other half the visited bits of a walk on the map (see workspace_begin_walk)
+int tileBudget = 64;
+
+// Destructor for TileCache structure
+void tile_cache_dtor(TileCache **cache)
+{
+    if(cache != NULL && *cache != NULL){
+        verbose_error("Tiles were loaded %lld times into %d slots\n", (*cache)->loads, (*cache)->usedSlots);
+        if((*cache)->fd != -1){
+            close((*cache)->fd);
+        }
+        if(!(*cache)->isCopy){
+            free((*cache)->rowOffsets);
+            free((*cache)->rowIsRegular);
+        }
+        free((*cache)->text);
+        free((*cache)->rowCells);
+        free((*cache)->cells);
+        free((*cache)->tileOfSlot);
+        free((*cache)->slotOfTile);
+        free((*cache)->newer);
+        free((*cache)->older);
+        free(*cache);
+        *cache = NULL;
+    }
+}
+
+//
+// Allocates the empty slots of cache, they fill up its share of the half of tileBudget MiB the tiles get
+// Text sources also get a buffer for the cells of a row, returns -1 on failure
+//
+int tile_cache_alloc_slots(TileCache *tiles)
+{
+    long long budgetSlots = (long long)tileBudget * 1024 * 1024 / 2 / tiles->shareCount / TILE_CELLS;
+    tiles->slotCount = budgetSlots < 2 ? 2 : budgetSlots > tiles->tileCount ? tiles->tileCount : (int)budgetSlots;
+    tiles->cells = malloc((size_t)tiles->slotCount * TILE_CELLS);
+    tiles->tileOfSlot = malloc(sizeof(int) * (size_t)tiles->slotCount);
+    tiles->newer = malloc(sizeof(int) * (size_t)tiles->slotCount);
+    tiles->older = malloc(sizeof(int) * (size_t)tiles->slotCount);
+    tiles->slotOfTile = malloc(sizeof(int) * (size_t)tiles->tileCount);
+    if(tiles->source == TILE_SOURCE_TEXT){
+        tiles->rowCells = malloc(row_buffer_size(tiles->cols));
+    }
+    if(tiles->cells == NULL || tiles->tileOfSlot == NULL || tiles->newer == NULL || tiles->older == NULL
+       || tiles->slotOfTile == NULL || (tiles->source == TILE_SOURCE_TEXT && tiles->rowCells == NULL)){
+        fprintf(stderr, "Malloc failed on tiles\n");
+        return -1;
+    }
+    for(int tile = 0; tile < tiles->tileCount; tile++){
+        tiles->slotOfTile[tile] = NO_TILE;
+    }
+    return 0;
+}
+
+//
+// Initializes an empty TileCache of a rows x cols maze read from fileName, slots fill up half of tileBudget MiB
+// Text sources also get room for the offsets of their rows, returns -1 on failure
+//
+int tile_cache_ctor(TileCache **cache, int rows, int cols, TileSource source, const char *fileName)
+{
+    *cache = calloc(1, sizeof(TileCache));
+    if(*cache == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return -1;
+    }
+    TileCache *tiles = *cache;
+    tiles->rows = rows;
+    tiles->cols = cols;
+    tiles->source = source;
+    tiles->tilesAcross = (cols + TILE_SIDE - 1) / TILE_SIDE;
+    tiles->newest = NO_TILE;
+    tiles->oldest = NO_TILE;
+    tiles->lastTile = NO_TILE;
+
+    // Pipes can't be read at an offset
+    struct stat fileInfo;
+    tiles->fd = open(fileName, O_RDONLY);
+    if(tiles->fd == -1 || fstat(tiles->fd, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode)){
+        fprintf(stderr, "Error --storage tiles needs a regular file\n");
+        tile_cache_dtor(cache);
+        return -1;
+    }
+
+    tiles->tileCount = tiles->tilesAcross * ((rows + TILE_SIDE - 1) / TILE_SIDE);
+    tiles->shareCount = 1;
+    if(tile_cache_alloc_slots(tiles) == -1){
+        tile_cache_dtor(cache);
+        return -1;
+    }
+    if(source == TILE_SOURCE_TEXT){
+        tiles->rowOffsets = malloc(sizeof(int64_t) * ((size_t)rows + 1));
+        tiles->rowIsRegular = malloc(sizeof(bool) * (size_t)rows);
+        if(tiles->rowOffsets == NULL || tiles->rowIsRegular == NULL){
+            fprintf(stderr, "Malloc failed on tiles\n");
+            tile_cache_dtor(cache);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//
+// Initializes an empty TileCache reading the same maze as cache for one of shareCount workers, every lookup changes
+// the state of a cache so workers can't share one. Row offsets are borrowed from cache, which has to outlive the copy
+// and isn't used while copies are, the file is read through a descriptor of its own. Returns -1 on failure
+//
+int tile_cache_copy(TileCache **copy, const TileCache *cache, int shareCount)
+{
+    *copy = calloc(1, sizeof(TileCache));
+    if(*copy == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return -1;
+    }
+    TileCache *tiles = *copy;
+    tiles->rows = cache->rows;
+    tiles->cols = cache->cols;
+    tiles->tilesAcross = cache->tilesAcross;
+    tiles->tileCount = cache->tileCount;
+    tiles->source = cache->source;
+    tiles->cellsOffset = cache->cellsOffset;
+    tiles->rowOffsets = cache->rowOffsets;
+    tiles->rowIsRegular = cache->rowIsRegular;
+    tiles->isCopy = true;
+    tiles->shareCount = shareCount;
+    tiles->newest = NO_TILE;
+    tiles->oldest = NO_TILE;
+    tiles->lastTile = NO_TILE;
+    tiles->fd = dup(cache->fd);
+    if(tiles->fd == -1){
+        fprintf(stderr, "Error opening the maze for a worker\n");
+        tile_cache_dtor(copy);
+        return -1;
+    }
+    if(tile_cache_alloc_slots(tiles) == -1){
+        tile_cache_dtor(copy);
+        return -1;
+    }
+    if(cache->text != NULL){
+        tiles->textSize = cache->textSize;
+        tiles->text = malloc(tiles->textSize);
+        if(tiles->text == NULL){
+            fprintf(stderr, "Malloc failed on tiles\n");
+            tile_cache_dtor(copy);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//
+// Reads the rows of a text maze once, validates them and keeps where each row starts so that tiles can be read later
+// The text is read once front to back, so the kernel can drop its pages behind the cursor
+// Returns -1 if a cell is missing or out of bounds
+//
+int tile_cache_index_text(TileCache *cache, const char *start, const char *cursor, const char *end, Validator *validator)
+{
+    unsigned char *buffer = calloc(row_buffer_size(cache->cols), sizeof(unsigned char));
+    if(buffer == NULL){
+        fprintf(stderr, "Malloc failed on row\n");
+        return -1;
+    }
+    unsigned char *cells = buffer + 1;
+
+    size_t longestRow = 0;
+    int result = ROW_READ;
+    for(int row = 1; row <= cache->rows; row++){
+        while(cursor < end && (*cursor == ' ' || (*cursor >= '\t' && *cursor <= '\r'))){
+            cursor++;
+        }
+        const char *rowStart = cursor;
+        int value;
+        result = scan_row(&cursor, end, cache->cols, cells, &value);
+        if(result != ROW_READ){
+            print_row_error(result, row, value);
+            break;
+        }
+        validator_push_row(validator, cells);
+        STATS_ADD(cellsValidated, cache->cols);
+
+        cache->rowOffsets[row-1] = rowStart - start;
+        cache->rowIsRegular[row-1] = cursor - rowStart == (long long)cache->cols * 2 - 1;
+        // Rows which aren't regular are read up to the start of the next one
+        if(row > 1 && (size_t)(rowStart - start - cache->rowOffsets[row-2]) > longestRow){
+            longestRow = (size_t)(rowStart - start - cache->rowOffsets[row-2]);
+        }
+    }
+    free(buffer);
+    if(result != ROW_READ){
+        return -1;
+    }
+
+    cache->rowOffsets[cache->rows] = cursor - start;
+    STATS_ADD(bytesParsed, cursor - start);
+    if((size_t)(cursor - start - cache->rowOffsets[cache->rows-1]) > longestRow){
+        longestRow = (size_t)(cursor - start - cache->rowOffsets[cache->rows-1]);
+    }
+    cache->textSize = longestRow > (size_t)TILE_SIDE * 2 ? longestRow : (size_t)TILE_SIDE * 2;
+    cache->text = malloc(cache->textSize);
+    if(cache->text == NULL){
+        fprintf(stderr, "Malloc failed on tiles\n");
+        return -1;
+    }
+    if(validator->validity == MAZE_WRONG_BORDERS){
+        print_wrong_borders(validator->invalidRow, validator->invalidCol);
+    }
+    return 0;
+}
+
+//
+// Initializes map from a compiled maze inside view, cells are used straight from the mapping without any parsing
+// map takes over view, with --storage tiles cells are read from fileName by a TileCache instead and with --storage planes
+// they are copied into bit planes, in both cases view is closed
+// Returns -1 if the file is damaged
+//
+int map_from_tmaze(Map *map, FileView *view, const char *fileName)
+{
+    const TmazeHeader *header = tmaze_header(view);
+    if(header == NULL){
+        return -1;
+    }
+    const TmazeSection *cells = tmaze_section(view, TMAZE_SECTION_CELLS);
+    if(cells == NULL || cells->size != (uint64_t)header->rows * header->cols){
+        fprintf(stderr, "Error compiled maze is damaged\n");
+        return -1;
+    }
+
+    map->rows = (int)header->rows;
+    map->cols = (int)header->cols;
+    map->storage = mapStorage;
+    map->cells = NULL;
+    map->planes = NULL;
+    map->planeStride = 0;
+    map->compiled = NULL;
+    map->isTmaze = true;
+    map->tiles = NULL;
+    if(map->storage == MAP_STORAGE_TILES){
+        if(tile_cache_ctor(&map->tiles, map->rows, map->cols, TILE_SOURCE_COMPILED, fileName) == -1){
+            return -1;
+        }
+        map->tiles->cellsOffset = (off_t)cells->offset;
+    } else if(map->storage == MAP_STORAGE_PLANES){
+        // Borders are the low bits of a packed cell, so rows go into the planes the same way parsed ones do
+        if(map_alloc_storage(map) == -1){
+            return -1;
+        }
+        const unsigned char *packed = (const unsigned char *)(view->data + cells->offset);
+        for(int r = 1; r <= map->rows; r++){
+            map_store_row(map, r, packed + (size_t)(r-1) * map->cols);
+        }
+    } else {
+        map->compiled = malloc(sizeof(FileView));
+        if(map->compiled == NULL){
+            fprintf(stderr, "Malloc failed\n");
+            return -1;
+        }
+        *map->compiled = *view;
+        // Never written, the mapping is read only
+        map->cells = (unsigned char *)(view->data + cells->offset);
+    }
+    map->validity = MAZE_VALID;
+    if(!(header->flags & TMAZE_FLAG_VALID)){
+        map->validity = MAZE_WRONG_BORDERS;
+        map->invalidRow = (int)header->invalidRow;
+        map->invalidCol = (int)header->invalidCol;
+        print_wrong_borders(map->invalidRow, map->invalidCol);
+    }
+    if(map->storage != MAP_STORAGE_BYTES){
+        file_view_close(view);
+    }
+    return 0;
+}
+
+// Destructor for Map structure
+void map_dtor(Map **map) {
+    if (map != NULL && *map != NULL) {
+        if((*map)->compiled != NULL){
+            file_view_close((*map)->compiled);
+            free((*map)->compiled);
+        } else {
+            free((*map)->cells);
+        }
+        free((*map)->planes);
+        tile_cache_dtor(&(*map)->tiles);
+        free(*map);
+        *map = NULL;
+    }
+}
+
+// Destructor for the first workerCount maps filled by map_worker_copies
+void map_worker_copies_dtor(Map *map, int workerCount, Map **maps)
+{
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        if(maps[workerIndex] != map){
+            tile_cache_dtor(&maps[workerIndex]->tiles);
+            free(maps[workerIndex]);
+        }
+        maps[workerIndex] = map;
+    }
+}
+
+//
+// Fills maps with a Map for every one of workerCount workers searching map at the same time
+// Only MAP_STORAGE_TILES changes while it's read, its workers get copies with a TileCache of their own which split
+// tileBudget between them. Every other storage is shared, returns -1 on failure
+//
+int map_worker_copies(Map *map, int workerCount, Map **maps)
+{
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        maps[workerIndex] = map;
+        if(map->storage != MAP_STORAGE_TILES){
+            continue;
+        }
+        Map *copy = malloc(sizeof(Map));
+        if(copy == NULL){
+            fprintf(stderr, "Malloc failed\n");
+            map_worker_copies_dtor(map, workerIndex, maps);
+            return -1;
+        }
+        *copy = *map;
+        if(tile_cache_copy(&copy->tiles, map->tiles, workerCount) == -1){
+            free(copy);
+            map_worker_copies_dtor(map, workerIndex, maps);
+            return -1;
+        }
+        maps[workerIndex] = copy;
+    }
+    return 0;
+}
+
+//
+// Reads the file of map_ctor, the file is read exactly once and contents are validated while parsing
+// Compiled mazes are mapped instead (see map_from_tmaze), returns -1 if the file can't be read at all
+//
+int map_load(Map **map, const char *fileName)
+{
+    FileView view;
+    if(file_view_open(&view, fileName) == -1){
+        return -1;
+    }
+
+    if(tmaze_is(&view)){
+        *map = malloc(sizeof(Map));
+        if(*map == NULL || map_from_tmaze(*map, &view, fileName) == -1){
+            if(*map == NULL){
+                fprintf(stderr, "Malloc failed\n");
+            }
+            free(*map);
+            *map = NULL;
+            file_view_close(&view);
+            return -1;
+        }
+        return 0;
+    }
+
+    const char *cursor = view.data;
+    int rows = 0, cols = 0;
+
+    if(scan_header(&cursor, view.end, &rows, &cols) == -1){
+        file_view_close(&view);
+        return -1;
+    }
+
+    *map = malloc(sizeof(Map));
+    if(*map == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        file_view_close(&view);
+        return -1;
+    }
+
+    (*map)->rows = rows;
+    (*map)->cols = cols;
+    (*map)->storage = mapStorage;
+    (*map)->compiled = NULL;
+    (*map)->isTmaze = false;
+    (*map)->tiles = NULL;
+
+    // Tiles only keep where the rows start, the maze is validated on the way and read again tile by tile
+    if(mapStorage == MAP_STORAGE_TILES){
+        Validator validator;
+        int result = -1;
+        if(tile_cache_ctor(&(*map)->tiles, rows, cols, TILE_SOURCE_TEXT, fileName) == 0
+           && validator_ctor(&validator, cols) == 0){
+            result = tile_cache_index_text((*map)->tiles, view.data, cursor, view.end, &validator);
+            (*map)->validity = validator.validity;
+            (*map)->invalidRow = validator.invalidRow;
+            (*map)->invalidCol = validator.invalidCol;
+            validator_dtor(&validator);
+        }
+        (*map)->cells = NULL;
+        (*map)->planes = NULL;
+        file_view_close(&view);
+        if(result == -1){
+            map_dtor(map);
+        }
+        return result;
+    }
+
+    // Allocates memory needed for all fields of the matrix
+    if(map_alloc_storage(*map) == -1){
+        map_dtor(map);
+        file_view_close(&view);
+        return -1;
+    }
+
+    // Planes are validated all at once after reading, bytes while reading
+    Validator validator;
+    if(mapStorage == MAP_STORAGE_BYTES && validator_ctor(&validator, cols) == -1){
+        map_dtor(map);
+        file_view_close(&view);
+        return -1;
+    }
+
+    int result = scan_cells(&cursor, view.end, rows, cols, mapStorage == MAP_STORAGE_BYTES ? &validator : NULL, *map);
+    file_view_close(&view);
+    if(mapStorage == MAP_STORAGE_BYTES){
+        (*map)->validity = validator.validity;
+        (*map)->invalidRow = validator.invalidRow;
+        (*map)->invalidCol = validator.invalidCol;
+        validator_dtor(&validator);
+    }
+    if(result == -1){
+        map_dtor(map);
+        return -1;
+    }
+
+    if(mapStorage == MAP_STORAGE_BYTES){
+        map_pack_cells(*map);
+        return 0;
+    }
+    (*map)->validity = MAZE_VALID;
+    if(map_validate_planes(*map, &(*map)->invalidRow, &(*map)->invalidCol) == -1){
+        (*map)->validity = MAZE_WRONG_BORDERS;
+        print_wrong_borders((*map)->invalidRow, (*map)->invalidCol);
+    }
+    return 0;
+}
+
+//
+// Initializes Map structure and cells array, allocates Map and unsigned char *cells
+// The result of validation is saved into map->validity, returns -1 if the file can't be read at all
+//
+int map_ctor(Map **map, const char *fileName)
+{
+    uint64_t started = STATS_NOW();
+    int result = map_load(map, fileName);
+    STATS_ADD(loadNs, STATS_NOW() - started);
+    return result;
+}
+
+//
+// Returns a value of a cell at row and column index like an array would
+//
+int get_cell_value(Map *map, int rowIndex, int columnIndex)
+{
+    // Index meaning 0 - x < rows 
+    if(rowIndex > map->rows || columnIndex > map->cols || rowIndex < 1 || columnIndex < 1){
+        verbose_error("Error row or column out of bounds\n");
+        return -1;
+    }
+    return (int)(map_packed_cell(map, rowIndex, columnIndex, (int64_t)(rowIndex-1) * map->cols + (columnIndex-1)) & BORDER_MASK);
+}
+
+//
+// Prints entire already initialized matrix saved inside Map structure
+//
+void print_entire_matrix(Map *map)
+{
+
+    for(int row = 1; row <= map->rows; row++){
+        for(int column = 1; column <= map->cols; column++){
+            printf(" %d", get_cell_value(map, row, column));
+        }
+        printf("\n");
+    }
+}
+
+//
+// Determines if a border is present in a certain Direction 
+// Returns 1 if there is a border, 0 if there isn't and -1 if r, c or border aren't valid
+//
+int isborder(Map *map, int r, int c, int border)
+{
+    
+    int cell = get_cell_value(map, r, c);
+    if(cell == -1){
+        verbose_error("Error cell [%d,%d] isn't valid\n", r, c);
+        return -1;
+    }
+    unsigned cellValue = (unsigned) cell;
+    
+    switch(border){
+        case L:
+            return isolate_bit_value(cellValue, LEFT_BIT);
+        break;
+        case R:
+            return isolate_bit_value(cellValue, RIGHT_BIT);
+        break;
+        case U:
+            return isolate_bit_value(cellValue, UPDOWN_BIT);
+        case D:
+            return isolate_bit_value(cellValue, UPDOWN_BIT);
+        break;
+
+        default:
+            verbose_error("Error direction %d doesn't exist\n", border);
+
+    }
+
+    return -1;
+}
+
+
+//
+// Returns a value of TriangleType
+//
+int determine_triangle_type(Position pos)
+{
+    if(pos.r < 1 || pos.c < 1){
+        verbose_error("Error triangle type couldn't be determined pos.r or pos.c are out of bounds\n");
+        return -1;
+    }
+
+    // Even Row
+    if(pos.r % 2 == 0){
+        if(pos.c % 2 == 1)
+            return CONTAINS_DOWN; // Has a DOWN border
+        else
+            return CONTAINS_UP; // Has an UP border
+    }
+
+    // Odd Row
+    if(pos.r % 2 == 1){
+        if(pos.c % 2 == 0)
+            return CONTAINS_DOWN; // Has a DOWN border
+        else
+            return CONTAINS_UP; // Has an UP border
+    }
+        
+    verbose_error("Error triangle type couldn't be determined pos.r or pos.c are out of bounds\n");
+    return -1;
+}
+
+//
+// Sets the maze boundary of an triangle returns a DEC value of 0-7
+//
+int determine_maze_boundary(Map *map, Triangle triangle)
+{
+    unsigned mazeBoundary = 0;
+    int r = triangle.pos.r, c = triangle.pos.c;
+    if(r < 1 || c < 1){
+        verbose_error("Error couldn't read position of triangle\n");
+        return -1;
+    }
+
+    if(r == 1 && triangle.type == CONTAINS_UP){
+        mazeBoundary += 1U << UPDOWN_BIT;     // Adds correct DEC value corresponding to the bit
+    } else if(r == map->rows && triangle.type == CONTAINS_DOWN){
+        mazeBoundary += 1U << UPDOWN_BIT;
+    }
+
+    if(c == 1){
+        mazeBoundary += 1U << LEFT_BIT;
+    } else if(c == map->cols){
+        mazeBoundary += 1U << RIGHT_BIT;
+    }
+    
+    return mazeBoundary;
+}
+
+// Initializes a triangle structure
+int initialize_triangle(Map *map, Triangle *triangle, int r, int c)
+{
+    if(r < 1 || c < 1){
+        verbose_error("Error initializing triangle\n");
+        return -1;
+    }
+    // Initializes all necesarry values
+    triangle->pos.r = r;
+    triangle->pos.c = c;
+    triangle->type = determine_triangle_type(triangle->pos);
+    triangle->borderValue = get_cell_value(map, r, c);
+    triangle->mazeBoundary = determine_maze_boundary(map, *triangle);
+    return 0;
+}
+
+// Checks if a side in direction is a boundary of the maze using triangle.mazeBoundary values defined in determine_maze_boundary
+bool is_maze_boundary(Triangle triangle, Direction checkDirection)
+{
+    
+    unsigned mazeBoundary = triangle.mazeBoundary;
+    
+    switch(checkDirection){
+        case L:
+            return isolate_bit_value(mazeBoundary, LEFT_BIT);
+        break;
+        case R:
+            return isolate_bit_value(mazeBoundary, RIGHT_BIT);
+        break;
+        case U:
+            return isolate_bit_value(mazeBoundary, UPDOWN_BIT);
+        case D:
+            return isolate_bit_value(mazeBoundary, UPDOWN_BIT);
+            break;
+        default:
+            verbose_error("Error direction %d doesn't exist\n", checkDirection);
+
+    }
+
+    return false;
+}
+
+// Returns the Side of a triangle that a move in direction passes through
+Side direction_side(Direction direction)
+{
+    if(direction == L){
+        return LEFT_SIDE;
+    }
+    return direction == R ? RIGHT_SIDE : VERTICAL_SIDE;
+}
+
+// Returns the side of the neighbouring triangle which is shared with side
+static inline Side side_facing(Side side)
+{
+    return side == LEFT_SIDE ? RIGHT_SIDE : side == RIGHT_SIDE ? LEFT_SIDE : VERTICAL_SIDE;
+}
+
+// Uses [Direction] as a means of changing the r and c values
+const Position directionVector[4] = {
+    {0, -1},    // move LEFT
+    {0, 1},     // move RIGHT
+    {-1, 0},    // move UP
+    {1, 0},     // move DOWN
+};
+
+// Returns a MoveResult signifying whether a resultingTriangle has been moved and set in a chosen direction correctly
+// Nothing is printed unless --verbose is used, a blocked move is the common case while searching the maze
+int triangle_move_in(Map *map, Triangle triangleToMove, Triangle *resultingTriangle, Direction direction)
+{
+    // Checks if a triangle even has a side to move to 
+    if(direction > D || direction < L){
+        verbose_error("Error direction value doesn't exist\n");
+        return MOVE_WRONG_DIRECTION;
+    }
+    if(triangleToMove.type == CONTAINS_UP && direction == D){
+        verbose_error("Error cannot move in that direction wrong TriangleType\n");
+        return MOVE_WRONG_DIRECTION;
     } else if(triangleToMove.type == CONTAINS_DOWN && direction == U){
-        fprintf(stderr, "Error cannot move in that direction wrong TriangleType\n");
-        return -2;
+        verbose_error("Error cannot move in that direction wrong TriangleType\n");
+        return MOVE_WRONG_DIRECTION;
+    }
+
+    int isBorderInDirection = isborder(map, triangleToMove.pos.r, triangleToMove.pos.c, direction);
+
+    if(isBorderInDirection == -1){
+        return MOVE_WRONG_DIRECTION;
+    }
+    if(isBorderInDirection){
+        verbose_error("Error cannot move in that direction border is in a way\n");
+        return MOVE_BLOCKED;
+    }
+    
+    // Illegal states
+    if(triangleToMove.pos.c == 1 && triangleToMove.pos.r == 1 && (direction == L || direction == U)){
+        verbose_error("Error cannot move in that direction\n");
+        return MOVE_LEFT_MAZE;
+    }
+    if(triangleToMove.pos.c == map->cols && triangleToMove.pos.r == map->rows && (direction == R || direction == D)){
+        verbose_error("Error cannot move in that direction\n");
+        return MOVE_LEFT_MAZE;
+    }
+
+    // resultingTriangle would've moved outside the maze resulting in the completion of the maze
+    if(triangleToMove.pos.c == map->cols && direction == R){
+        return MOVE_LEFT_MAZE;
+    }
+    if(triangleToMove.pos.c == 1 && direction == L){
+        return MOVE_LEFT_MAZE;
+    }
+    if(triangleToMove.pos.r == map->rows && direction == D){
+        return MOVE_LEFT_MAZE;
+    }
+    if(triangleToMove.pos.r == 1 && direction == U){
+        return MOVE_LEFT_MAZE;
+    }
+    
+    // Matches array indexes to Direction enum by -1 to account for it starting at L=1
+    initialize_triangle(map, resultingTriangle, triangleToMove.pos.r + directionVector[direction-1].r,triangleToMove.pos.c + directionVector[direction-1].c);
+    return MOVE_SUCCESS;
+
+}
+
+// Formats of a path printed by --rpath, --lpath and --shortest
+typedef enum {
+    PATH_TEXT, // "r,c" lines
+    PATH_BINARY, // Pairs of little endian uint32 r and c
+    PATH_LENGTH, // Only the number of positions, paths of search_maze aren't walked through inside of corridors
+    PATH_PACKED, // Start position followed by a 2-bit MoveCode for every step
+    PATH_PACKED_RLE, // PATH_PACKED with long runs of the same move stored as their length
+} PathFormat;
+
+//
+// Packed paths start with PACKED_PATH_MAGIC, a version byte, 3 zero bytes and the first position as little endian
+// uint32 r and c. Every next position is a MoveCode, four of them in a byte starting from the lowest bits.
+// MOVE_ESCAPE is followed by one more code telling what comes next, data of an escape starts at the next whole byte
+//
+#define PACKED_PATH_MAGIC "MZPK"
+#define PACKED_PATH_VERSION 1
+// Runs of the same move which are shorter than this are cheaper to store move by move
+#define PACKED_RUN_MIN 12
+
+typedef enum {
+    MOVE_LEFT, // c - 1
+    MOVE_RIGHT, // c + 1
+    MOVE_VERTICAL, // r - 1 in a triangle with an up border, r + 1 otherwise
+    MOVE_ESCAPE,
+} MoveCode;
+
+// Codes following MOVE_ESCAPE
+typedef enum {
+    ESCAPE_END, // Path ends here
+    ESCAPE_RUN, // Previous move is repeated as many more times as the following LEB128 number says
+    ESCAPE_JUMP, // Path continues at the following uint32 r and c, used for positions that aren't neighbours
+} EscapeCode;
+
+// Size of the buffer of PathSink, path is written out only once it fills up
+#define PATH_SINK_CAPACITY (256 * 1024)
+// Used instead of a file descriptor for a PathSink which keeps the whole path in its growing buffer
+#define PATH_SINK_MEMORY -1
+
+// Collects positions of a path and writes them into a file descriptor in large batches
+typedef struct {
+    int fd;
+    PathFormat format;
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    bool failed; // Set once a write fails, the rest of the path is dropped
+    long long positions; // Positions counted by PATH_LENGTH
+    // Used only by packed formats
+    bool hasPosition; // Set once the first position was written
+    int r, c; // Last position of the path
+    unsigned bits; // Codes that don't fill a whole byte yet
+    int bitCount;
+    MoveCode runMove; // Move repeated runLength times which isn't written yet, only used by PATH_PACKED_RLE
+    long long runLength;
+} PathSink;
+
+// Set by --format, used for every PathSink created by main
+PathFormat pathFormat = PATH_TEXT;
+
+// Initializes a PathSink writing into fd or keeping the path in memory if fd is PATH_SINK_MEMORY
+int path_sink_ctor(PathSink *sink, int fd, PathFormat format)
+{
+    sink->capacity = fd == PATH_SINK_MEMORY ? 4096 : PATH_SINK_CAPACITY;
+    sink->buffer = malloc(sink->capacity);
+    if(sink->buffer == NULL){
+        fprintf(stderr, "Malloc failed on path buffer\n");
+        return -1;
+    }
+    sink->fd = fd;
+    sink->format = format;
+    sink->used = 0;
+    sink->failed = false;
+    sink->positions = 0;
+    sink->hasPosition = false;
+    sink->bits = 0;
+    sink->bitCount = 0;
+    sink->runLength = 0;
+    return 0;
+}
+
+// Writes out everything collected in the buffer, returns -1 if the write fails
+int path_sink_flush(PathSink *sink)
+{
+    if(sink->fd == PATH_SINK_MEMORY){
+        return sink->failed ? -1 : 0;
+    }
+    size_t written = 0;
+    while(written < sink->used && !sink->failed){
+        ssize_t result = write(sink->fd, sink->buffer + written, sink->used - written);
+        if(result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            // Sockets of --serve are non-blocking, the answer waits until the client takes more of it
+            struct pollfd writable = {.fd = sink->fd, .events = POLLOUT};
+            if(poll(&writable, 1, -1) == -1 && errno != EINTR){
+                fprintf(stderr, "Error writing path\n");
+                sink->failed = true;
+            }
+        } else if(result == -1 && errno != EINTR){
+            fprintf(stderr, "Error writing path\n");
+            sink->failed = true;
+        } else if(result > 0){
+            written += (size_t)result;
+        }
+    }
+    sink->used = 0;
+    return sink->failed ? -1 : 0;
+}
+
+// Makes room for length more bytes, sinks writing into a file are flushed and memory sinks grow
+int path_sink_reserve(PathSink *sink, size_t length)
+{
+    if(sink->failed){
+        return -1;
+    }
+    if(sink->fd != PATH_SINK_MEMORY){
+        return path_sink_flush(sink);
+    }
+
+    size_t capacity = sink->capacity;
+    while(capacity - sink->used < length){
+        capacity *= 2;
+    }
+    char *grown = realloc(sink->buffer, capacity);
+    if(grown == NULL){
+        fprintf(stderr, "Malloc failed on path buffer\n");
+        sink->failed = true;
+        return -1;
+    }
+    sink->buffer = grown;
+    sink->capacity = capacity;
+    return 0;
+}
+
+// Two ASCII digits of every number 0-99, used by format_uint
+static const char digitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes value in decimal into out, returns the number of characters written (at most 10)
+static inline int format_uint(char *out, unsigned value)
+{
+    char digits[10];
+    int pos = 10;
+    while(value >= 100){
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        digits[--pos] = digitPairs[pair + 1];
+        digits[--pos] = digitPairs[pair];
+    }
+    if(value >= 10){
+        digits[--pos] = digitPairs[value * 2 + 1];
+        digits[--pos] = digitPairs[value * 2];
+    } else {
+        digits[--pos] = (char)('0' + value);
+    }
+    memcpy(out, digits + pos, 10 - pos);
+    return 10 - pos;
+}
+
+// Writes value as 4 little endian bytes into out
+static inline void format_uint32_le(char *out, unsigned value)
+{
+    out[0] = (char)(value & 0xFF);
+    out[1] = (char)((value >> 8) & 0xFF);
+    out[2] = (char)((value >> 16) & 0xFF);
+    out[3] = (char)((value >> 24) & 0xFF);
+}
+
+// Adds text that isn't part of a path into sink
+void path_sink_write(PathSink *sink, const char *text, size_t length)
+{
+    if(sink->capacity - sink->used < length && path_sink_reserve(sink, length) == -1){
+        return;
+    }
+    // Larger than the whole buffer, written out directly
+    if(sink->capacity - sink->used < length){
+        const char *buffer = sink->buffer;
+        size_t used = sink->used;
+        sink->buffer = (char *)text;
+        sink->used = length;
+        path_sink_flush(sink);
+        sink->buffer = (char *)buffer;
+        sink->used = used;
+        return;
+    }
+    memcpy(sink->buffer + sink->used, text, length);
+    sink->used += length;
+}
+
+// Adds a code of a packed path into sink, room for the byte it may fill has to be reserved
+static inline void path_sink_code(PathSink *sink, unsigned code)
+{
+    sink->bits |= code << sink->bitCount;
+    sink->bitCount += 2;
+    if(sink->bitCount == 8){
+        sink->buffer[sink->used++] = (char)sink->bits;
+        sink->bits = 0;
+        sink->bitCount = 0;
+    }
+}
+
+// Writes out the codes that don't fill a whole byte, the unused bits are zero
+static inline void path_sink_align(PathSink *sink)
+{
+    if(sink->bitCount > 0){
+        sink->buffer[sink->used++] = (char)sink->bits;
+        sink->bits = 0;
+        sink->bitCount = 0;
+    }
+}
+
+// Adds an escape with the position r, c of a packed path into sink, room for 10 bytes has to be reserved
+static void path_sink_jump(PathSink *sink, int r, int c)
+{
+    path_sink_code(sink, MOVE_ESCAPE);
+    path_sink_code(sink, ESCAPE_JUMP);
+    path_sink_align(sink);
+    format_uint32_le(sink->buffer + sink->used, (unsigned)r);
+    format_uint32_le(sink->buffer + sink->used + 4, (unsigned)c);
+    sink->used += 8;
+}
+
+// Writes out the moves of the pending run, room for 13 bytes has to be reserved
+static void path_sink_run(PathSink *sink)
+{
+    long long repeats = sink->runLength;
+    sink->runLength = 0;
+    if(repeats < PACKED_RUN_MIN){
+        while(repeats-- > 0){
+            path_sink_code(sink, sink->runMove);
+        }
+        return;
+    }
+    path_sink_code(sink, sink->runMove);
+    path_sink_code(sink, MOVE_ESCAPE);
+    path_sink_code(sink, ESCAPE_RUN);
+    path_sink_align(sink);
+    for(unsigned long long rest = (unsigned long long)repeats - 1; ; rest >>= 7){
+        sink->buffer[sink->used++] = (char)((rest & 0x7F) | (rest >= 0x80 ? 0x80 : 0));
+        if(rest < 0x80){
+            break;
+        }
+    }
+}
+
+// Adds a position r, c into a sink of a packed format, room for 22 bytes has to be reserved
+static void path_sink_push_packed(PathSink *sink, int r, int c)
+{
+    if(!sink->hasPosition){
+        memcpy(sink->buffer + sink->used, PACKED_PATH_MAGIC "\x00\x00\x00\x00", 8);
+        sink->buffer[sink->used + 4] = PACKED_PATH_VERSION;
+        format_uint32_le(sink->buffer + sink->used + 8, (unsigned)r);
+        format_uint32_le(sink->buffer + sink->used + 12, (unsigned)c);
+        sink->used += 16;
+        sink->hasPosition = true;
+        sink->r = r;
+        sink->c = c;
+        return;
+    }
+
+    MoveCode move = MOVE_ESCAPE;
+    if(r == sink->r && c == sink->c - 1){
+        move = MOVE_LEFT;
+    } else if(r == sink->r && c == sink->c + 1){
+        move = MOVE_RIGHT;
+    } else if(c == sink->c && r == sink->r + ((sink->r + sink->c) % 2 == 0 ? -1 : 1)){
+        move = MOVE_VERTICAL;
+    }
+    sink->r = r;
+    sink->c = c;
+
+    if(sink->format == PATH_PACKED_RLE && move != MOVE_ESCAPE){
+        if(sink->runLength > 0 && move != sink->runMove){
+            path_sink_run(sink);
+        }
+        sink->runMove = move;
+        sink->runLength++;
+        return;
+    }
+    if(sink->runLength > 0){
+        path_sink_run(sink);
+    }
+    if(move == MOVE_ESCAPE){
+        path_sink_jump(sink, r, c);
+    } else {
+        path_sink_code(sink, move);
+    }
+}
+
+// Ends a path in sink, writes the number of positions of PATH_LENGTH or the end of a packed path
+void path_sink_end(PathSink *sink)
+{
+    if(sink->format == PATH_LENGTH && sink->positions > 0){
+        char line[32];
+        int length = snprintf(line, sizeof(line), "%lld\n", sink->positions);
+        sink->positions = 0;
+        path_sink_write(sink, line, length);
+        return;
+    }
+    if(sink->format < PATH_PACKED || !sink->hasPosition || sink->failed){
+        return;
+    }
+    if(sink->capacity - sink->used < 22 && path_sink_reserve(sink, 22) == -1){
+        return;
+    }
+    if(sink->runLength > 0){
+        path_sink_run(sink);
+    }
+    path_sink_code(sink, MOVE_ESCAPE);
+    path_sink_code(sink, ESCAPE_END);
+    path_sink_align(sink);
+    sink->hasPosition = false;
+}
+
+// Adds a position r, c of a path into sink
+static inline void path_sink_push(PathSink *sink, int r, int c)
+{
+    if(sink->format == PATH_LENGTH){
+        sink->positions++;
+        return;
+    }
+    // Longest entry is "rrrrrrrrrr,cccccccccc\n"
+    if(sink->capacity - sink->used < 22 && path_sink_reserve(sink, 22) == -1){
+        return;
+    }
+
+    char *out = sink->buffer + sink->used;
+    if(sink->format >= PATH_PACKED){
+        path_sink_push_packed(sink, r, c);
+        return;
+    }
+    if(sink->format == PATH_BINARY){
+        format_uint32_le(out, (unsigned)r);
+        format_uint32_le(out + 4, (unsigned)c);
+        sink->used += 8;
+        return;
+    }
+    int length = format_uint(out, (unsigned)r);
+    out[length++] = ',';
+    length += format_uint(out + length, (unsigned)c);
+    out[length++] = '\n';
+    sink->used += length;
+}
+
+// Flushes and releases the buffer of sink
+int path_sink_dtor(PathSink *sink)
+{
+    path_sink_end(sink);
+    int result = path_sink_flush(sink);
+    free(sink->buffer);
+    sink->buffer = NULL;
+    return result;
+}
+
+// Reads 4 little endian bytes of in
+static inline unsigned parse_uint32_le(const char *in)
+{
+    const unsigned char *bytes = (const unsigned char *)in;
+    return bytes[0] | (unsigned)bytes[1] << 8 | (unsigned)bytes[2] << 16 | (unsigned)bytes[3] << 24;
+}
+
+//
+// Used for --decode-path, writes every position of a path printed by '--format packed' or '--format rle' in fileName
+// into sink. Returns -1 if the file isn't a packed path or ends before the path does
+//
+int decode_path(const char *fileName, PathSink *sink)
+{
+    FileView view;
+    if(file_view_open(&view, fileName) == -1){
+        return -1;
+    }
+    const char *in = view.data, *end = view.end;
+    if(end - in < 16 || memcmp(in, PACKED_PATH_MAGIC, 4) != 0 || in[4] != PACKED_PATH_VERSION){
+        fprintf(stderr, "Error %s isn't a packed path\n", fileName);
+        file_view_close(&view);
+        return -1;
+    }
+    int r = (int)parse_uint32_le(in + 8), c = (int)parse_uint32_le(in + 12);
+    in += 16;
+    path_sink_push(sink, r, c);
+
+    // Codes of the byte in are read from bit onwards
+    int bit = 0;
+    MoveCode move = MOVE_ESCAPE;
+    int result = -1;
+    while(in < end && !sink->failed){
+        unsigned code = ((unsigned char)*in >> bit) & 0x03;
+        unsigned long long repeats = 1;
+        bit += 2;
+        if(code == MOVE_ESCAPE){
+            if(bit == 8){
+                in++;
+                bit = 0;
+            }
+            if(in == end){
+                break;
+            }
+            unsigned escape = ((unsigned char)*in >> bit) & 0x03;
+            // Data of the escape starts at the next whole byte
+            in++;
+            bit = 0;
+            if(escape == ESCAPE_END){
+                result = 0;
+                break;
+            }
+            if(escape == ESCAPE_JUMP){
+                if(end - in < 8){
+                    break;
+                }
+                r = (int)parse_uint32_le(in);
+                c = (int)parse_uint32_le(in + 4);
+                in += 8;
+                path_sink_push(sink, r, c);
+                move = MOVE_ESCAPE;
+                continue;
+            }
+            repeats = 0;
+            int shift = 0;
+            while(in < end && shift < 63 && (unsigned char)*in & 0x80){
+                repeats |= (unsigned long long)(*in++ & 0x7F) << shift;
+                shift += 7;
+            }
+            if(escape != ESCAPE_RUN || move == MOVE_ESCAPE || in == end || (unsigned char)*in & 0x80){
+                break;
+            }
+            repeats |= (unsigned long long)(*in++ & 0x7F) << shift;
+        } else {
+            move = code;
+            if(bit == 8){
+                in++;
+                bit = 0;
+            }
+        }
+
+        for(; repeats > 0; repeats--){
+            if(move == MOVE_VERTICAL){
+                r += (r + c) % 2 == 0 ? -1 : 1;
+            } else {
+                c += move == MOVE_LEFT ? -1 : 1;
+            }
+            path_sink_push(sink, r, c);
+        }
+    }
+    file_view_close(&view);
+    if(result == -1 && !sink->failed){
+        fprintf(stderr, "Error packed path %s is damaged\n", fileName);
+    }
+    return result;
+}
+
+// Order in which the hand rule tries directions, indexed by [hand][TriangleType], [0] = L and [1] = R hand
+// rpath == lpath in downpointing triangle where .type == CONTAINS_UP
+const Direction handOrder[2][2][4] = {
+    {{0, R, L, U}, {0, L, R, D}},
+    {{0, L, R, U}, {0, R, L, D}},
+};
+
+//
+// Returns the heading (index into handOrder) the hand rule starts with in the triangle r, c, -1 on failure
+// The path enters through the first open side on the maze boundary in the order L, R, U, D and the hand rule
+// then turns from it, so the heading is the index of that side's Direction
+//
+int start_border(Map *map, int r, int c, int hand)
+{
+    Triangle chosenTriangle;
+    initialize_triangle(map, &chosenTriangle, r, c);
+    if(chosenTriangle.mazeBoundary == 0){
+        fprintf(stderr, "Error wrong args R and C -> cannot start in the middle\n");
+        return -1;
+    }
+
+    const Direction *order = handOrder[hand][chosenTriangle.type];
+    const Direction dirOrder[] = {L, R, U, D};
+    for(int dirIndex = 0; dirIndex < 4; dirIndex++){
+        Direction entryDirection = dirOrder[dirIndex];
+        // Only one of U and D is a side of the triangle, it's always the last one tried
+        if(entryDirection != order[1] && entryDirection != order[2] && entryDirection != order[3]){
+            continue;
+        }
+        if(isborder(map, r, c, entryDirection) == 0 && is_maze_boundary(chosenTriangle, entryDirection) == 1){
+            return entryDirection == order[1] ? 1 : entryDirection == order[2] ? 2 : 3;
+        }
+    }
+
+    fprintf(stderr, "Error starting border couldn't be determined\n");
+    return -1;
+}
+
+// Set by --max-steps, 0 means search_maze isn't limited
+long long maxSteps = 0;
+
+// Layout of transitionTable entries, 0 means the triangle is closed from all sides
+#define TRANSITION_HEADING_MASK 0x03 // Index into handOrder the triangle is left with
+#define TRANSITION_DIRECTION_SHIFT 2 // 3 bits with Direction of the move
+#define TRANSITION_EXIT_BIT 5 // Move leaves the maze
+#define TRANSITION_SIDE_SHIFT 6 // 2 bits with Side the triangle is left through
+
+// Next move of the hand rule indexed by [hand][packed cell value][heading the triangle was entered with]
+unsigned char transitionTable[2][PACKED_CELL_VALUES][4];
+
+//
+// Fills transitionTable, the hand rule keeps turning from the heading it entered a triangle with
+// until it finds a side without a border (the same way it was done by comparing changeDirection arrays)
+//
+void transition_table_init()
+{
+    for(int hand = 0; hand < 2; hand++){
+        for(unsigned packed = 0; packed < PACKED_CELL_VALUES; packed++){
+            const Direction *order = handOrder[hand][isolate_bit_value(packed, ORIENTATION_BIT) ? CONTAINS_DOWN : CONTAINS_UP];
+            for(int heading = 1; heading < 4; heading++){
+                unsigned char entry = 0;
+                for(int turn = 1; turn <= 3; turn++){
+                    int nextHeading = (heading + turn - 1) % 3 + 1;
+                    Direction direction = order[nextHeading];
+                    Side side = direction_side(direction);
+                    // Side and BitIndex share values
+                    if(!isolate_bit_value(packed, (BitIndex)side)){
+                        entry = nextHeading | direction << TRANSITION_DIRECTION_SHIFT | side << TRANSITION_SIDE_SHIFT;
+                        if(isolate_bit_value(packed >> BOUNDARY_SHIFT, (BitIndex)side)){
+                            entry |= 1U << TRANSITION_EXIT_BIT;
+                        }
+                        break;
+                    }
+                }
+                transitionTable[hand][packed][heading] = entry;
+            }
+        }
+    }
+}
+
+// Number of words of SearchWorkspace.visited remembered for clearing, a longer search clears the whole bitset
+#define WORKSPACE_TOUCHED_LIMIT 4096
+
+// Growable array of cell indexes, used for the frontiers of --search bidirectional and astar
+typedef struct {
+    int *items;
+    size_t count;
+    size_t capacity;
+} IndexList;
+
+// Appends cellIndex to list, returns -1 on failure
+static inline int index_list_push(IndexList *list, int cellIndex)
+{
+    if(list->count == list->capacity){
+        size_t capacity = list->capacity == 0 ? 1024 : list->capacity * 2;
+        int *items = realloc(list->items, sizeof(int) * capacity);
+        if(items == NULL){
+            fprintf(stderr, "Malloc failed on search frontier\n");
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = cellIndex;
+    return 0;
+}
+
+// Number of IndexLists kept by SearchWorkspace, current and next frontier of both directions
+#define WORKSPACE_LISTS 4
+// Words of the visited bits of a single tile, kept by SearchWorkspace for walks on MAP_STORAGE_TILES
+#define VISITED_BLOCK_WORDS ((size_t)TILE_CELLS * NUM_OF_SIDES / 64)
+
+//
+// Memory used by search_maze and shortest_path, kept between searches so that a search only pays for what it visits
+// Every part is allocated on first use, zero filled pages of untouched cells don't take up any memory
+//
+typedef struct {
+    int64_t cellCount;
+    // shortest_path: parent[cellIndex] is valid only when stamp[cellIndex] == generation
+    unsigned generation;
+    unsigned *stamp;
+    int *parent;
+    int *queue;
+    // --search bidirectional: cells of the reverse search and the next cell towards an exit
+    // --search astar: closed cells and the number of moves from the start
+    unsigned *otherStamp;
+    int *otherParent;
+    IndexList lists[WORKSPACE_LISTS];
+    // search_maze: 3 bits per cell, all zero between searches
+    uint64_t *visited;
+    size_t touched[WORKSPACE_TOUCHED_LIMIT];
+    int touchedCount; // More than WORKSPACE_TOUCHED_LIMIT means the whole bitset has to be cleared
+    // search_maze on MAP_STORAGE_TILES: the same bits in a block for every tile the walk entered, bounded by tileBudget
+    uint64_t **blockOfTile; // Every tile of the maze, NULL until the walk enters it
+    int *blockTiles; // Tiles which got a block, blockCount of at most blockLimit
+    int blockCount;
+    int blockLimit;
+    int tilesAcross;
+    int lastTile; // Tile of the previous lookup, skips blockOfTile for the usual run of moves inside one tile
+    uint64_t *lastBlock;
+} SearchWorkspace;
+
+// Initializes an empty SearchWorkspace for a maze with cellCount cells
+void workspace_ctor(SearchWorkspace *workspace, int64_t cellCount)
+{
+    workspace->cellCount = cellCount;
+    workspace->generation = 0;
+    workspace->stamp = NULL;
+    workspace->parent = NULL;
+    workspace->queue = NULL;
+    workspace->otherStamp = NULL;
+    workspace->otherParent = NULL;
+    for(int listIndex = 0; listIndex < WORKSPACE_LISTS; listIndex++){
+        workspace->lists[listIndex] = (IndexList){NULL, 0, 0};
+    }
+    workspace->visited = NULL;
+    workspace->touchedCount = 0;
+    workspace->blockOfTile = NULL;
+    workspace->blockTiles = NULL;
+    workspace->blockCount = 0;
+    workspace->lastTile = NO_TILE;
+}
+
+// Destructor for SearchWorkspace structure
+void workspace_dtor(SearchWorkspace *workspace)
+{
+    free(workspace->stamp);
+    free(workspace->parent);
+    free(workspace->queue);
+    free(workspace->otherStamp);
+    free(workspace->otherParent);
+    for(int listIndex = 0; listIndex < WORKSPACE_LISTS; listIndex++){
+        free(workspace->lists[listIndex].items);
+    }
+    free(workspace->visited);
+    for(int block = 0; block < workspace->blockCount; block++){
+        free(workspace->blockOfTile[workspace->blockTiles[block]]);
+    }
+    free(workspace->blockOfTile);
+    free(workspace->blockTiles);
+    workspace_ctor(workspace, workspace->cellCount);
+}
+
+// Size of SearchWorkspace.visited in 64 bit words
+static inline size_t workspace_visited_words(SearchWorkspace *workspace)
+{
+    return ((size_t)workspace->cellCount * NUM_OF_SIDES + 63) / 64;
+}
+
+//
+// Starts a new shortest_path search, all cells become unvisited, returns -1 on failure
+// withOther also prepares otherStamp and otherParent for the searches which need two marks per cell
+//
+int workspace_begin_bfs(SearchWorkspace *workspace, bool withOther)
+{
+    if(workspace->stamp == NULL){
+        workspace->stamp = calloc((size_t)workspace->cellCount, sizeof(unsigned));
+        workspace->parent = malloc(sizeof(int) * (size_t)workspace->cellCount);
+        // Ring buffer, every cell is queued at most once so cellCount slots are always enough
+        workspace->queue = malloc(sizeof(int) * (size_t)workspace->cellCount);
+        if(workspace->stamp == NULL || workspace->parent == NULL || workspace->queue == NULL){
+            fprintf(stderr, "Malloc failed on search workspace\n");
+            workspace_dtor(workspace);
+            return -1;
+        }
+    }
+    if(withOther && workspace->otherStamp == NULL){
+        workspace->otherStamp = calloc((size_t)workspace->cellCount, sizeof(unsigned));
+        workspace->otherParent = malloc(sizeof(int) * (size_t)workspace->cellCount);
+        if(workspace->otherStamp == NULL || workspace->otherParent == NULL){
+            fprintf(stderr, "Malloc failed on search workspace\n");
+            workspace_dtor(workspace);
+            return -1;
+        }
+    }
+
+    // Stamps would start matching old searches again
+    if(++workspace->generation == 0){
+        memset(workspace->stamp, 0, sizeof(unsigned) * (size_t)workspace->cellCount);
+        if(workspace->otherStamp != NULL){
+            memset(workspace->otherStamp, 0, sizeof(unsigned) * (size_t)workspace->cellCount);
+        }
+        workspace->generation = 1;
+    }
+    for(int listIndex = 0; listIndex < WORKSPACE_LISTS; listIndex++){
+        workspace->lists[listIndex].count = 0;
+    }
+    return 0;
+}
+
+//
+// Starts a new search_maze search on map with an empty visited bitset, returns -1 on failure
+// A bitset for every cell of MAP_STORAGE_TILES wouldn't fit into memory, its walks get a block of bits for each tile
+// they enter instead and the blocks are limited to their share of the half of tileBudget the tiles don't use
+//
+int workspace_begin_walk(SearchWorkspace *workspace, Map *map)
+{
+    if(map->storage == MAP_STORAGE_TILES){
+        if(workspace->blockOfTile == NULL){
+            // Workspaces of workers searching the same maze split it like their tile caches do
+            long long blockLimit = (long long)tileBudget * 1024 * 1024 / 2 / map->tiles->shareCount
+                                 / (sizeof(uint64_t) * VISITED_BLOCK_WORDS);
+            workspace->blockLimit = blockLimit < 1 ? 1 : blockLimit > map->tiles->tileCount ? map->tiles->tileCount : (int)blockLimit;
+            workspace->tilesAcross = map->tiles->tilesAcross;
+            workspace->blockOfTile = calloc((size_t)map->tiles->tileCount, sizeof(uint64_t *));
+            workspace->blockTiles = malloc(sizeof(int) * (size_t)workspace->blockLimit);
+            if(workspace->blockOfTile == NULL || workspace->blockTiles == NULL){
+                fprintf(stderr, "Malloc failed on visited\n");
+                workspace_dtor(workspace);
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if(workspace->visited == NULL){
+        workspace->visited = calloc(workspace_visited_words(workspace), sizeof(uint64_t));
+        if(workspace->visited == NULL){
+            fprintf(stderr, "Malloc failed on visited\n");
+            return -1;
+        }
+    }
+    workspace->touchedCount = 0;
+    return 0;
+}
+
+// Clears the bits set since workspace_begin_walk, blocks of tiles are given back
+void workspace_end_walk(SearchWorkspace *workspace)
+{
+    for(int block = 0; block < workspace->blockCount; block++){
+        free(workspace->blockOfTile[workspace->blockTiles[block]]);
+        workspace->blockOfTile[workspace->blockTiles[block]] = NULL;
+    }
+    workspace->blockCount = 0;
+    workspace->lastTile = NO_TILE;
+    if(workspace->touchedCount > WORKSPACE_TOUCHED_LIMIT){
+        memset(workspace->visited, 0, sizeof(uint64_t) * workspace_visited_words(workspace));
+    } else {
+        for(int touchedIndex = 0; touchedIndex < workspace->touchedCount; touchedIndex++){
+            workspace->visited[workspace->touched[touchedIndex]] = 0;
+        }
+    }
+    workspace->touchedCount = 0;
+}
+
+//
+// Returns the visited bits holding triangle r, c with *bit set to its first bit, cellIndex has to match r and c
+// Walks on tiles get a new block when they enter a tile, returns NULL once the walk can't have any more blocks
+//
+static inline uint64_t *workspace_visited_bits(SearchWorkspace *workspace, int r, int c, int64_t cellIndex, size_t *bit)
+{
+    if(workspace->blockOfTile == NULL){
+        *bit = (size_t)cellIndex * NUM_OF_SIDES;
+        return workspace->visited;
+    }
+
+    int tile = (r-1) / TILE_SIDE * workspace->tilesAcross + (c-1) / TILE_SIDE;
+    if(tile != workspace->lastTile){
+        uint64_t *block = workspace->blockOfTile[tile];
+        if(block == NULL){
+            if(workspace->blockCount == workspace->blockLimit){
+                return NULL;
+            }
+            block = calloc(VISITED_BLOCK_WORDS, sizeof(uint64_t));
+            if(block == NULL){
+                return NULL;
+            }
+            workspace->blockOfTile[tile] = block;
+            workspace->blockTiles[workspace->blockCount++] = tile;
+        }
+        workspace->lastTile = tile;
+        workspace->lastBlock = block;
+    }
+    *bit = (size_t)((r-1) % TILE_SIDE * TILE_SIDE + (c-1) % TILE_SIDE) * NUM_OF_SIDES;
+    return workspace->lastBlock;
+}
+
+// Returns true if the walk already left triangle r, c through any of its sides, used by --stats
+static inline bool workspace_left_before(SearchWorkspace *workspace, int r, int c, int64_t cellIndex)
+{
+    size_t bit;
+    const uint64_t *visited = workspace_visited_bits(workspace, r, c, cellIndex, &bit);
+    for(int side = 0; visited != NULL && side < NUM_OF_SIDES; side++, bit++){
+        if(visited[bit / 64] >> (bit % 64) & 1){
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Sets the visited bit of side of triangle r, c, cellIndex has to match r and c
+// Returns 1 if it was already set, 0 if it wasn't and -1 if a walk on tiles ran out of its share of tileBudget
+//
+static inline int workspace_visit(SearchWorkspace *workspace, int r, int c, int64_t cellIndex, int side)
+{
+    size_t bit;
+    uint64_t *visited = workspace_visited_bits(workspace, r, c, cellIndex, &bit);
+    if(visited == NULL && workspace->blockCount == workspace->blockLimit){
+        fprintf(stderr, "Error path entered more tiles than --memory-budget has room for, %d of them\n", workspace->blockLimit);
+        return -1;
+    } else if(visited == NULL){
+        fprintf(stderr, "Malloc failed on visited\n");
+        return -1;
+    }
+    bit += (size_t)side;
+    uint64_t *word = &visited[bit / 64];
+    uint64_t mask = 1ULL << (bit % 64);
+    if(*word & mask){
+        return 1;
+    }
+    // Blocks of tiles are given back whole, only the single bitset needs to know which words to clear
+    if(*word == 0 && visited == workspace->visited && workspace->touchedCount <= WORKSPACE_TOUCHED_LIMIT){
+        if(workspace->touchedCount < WORKSPACE_TOUCHED_LIMIT){
+            workspace->touched[workspace->touchedCount] = bit / 64;
+        }
+        workspace->touchedCount++;
+    }
+    *word |= mask;
+    return 0;
+}
+
+// Magic at the start of a sidecar written by --corridors and its format version
+#define CORRIDORS_MAGIC "TMAZECOR"
+#define CORRIDORS_VERSION 1
+// Label of a triangle which isn't inside of any corridor
+#define NO_CORRIDOR UINT32_MAX
+//
+// Shorter chains are walked through move by move, a jump costs more cache misses than a few moves
+// 4 measured fastest on generated perfect mazes, whose --format length walks take about 2/3 of the time without a
+// sidecar. Braided mazes gain nothing, only mazes made of long corridors like serpentine ones gain an order of magnitude
+//
+#define CORRIDOR_MIN_LENGTH 4
+
+//
+// Chain of triangles with exactly two open sides and none of them leading outside of the maze
+// The hand rule has no choice inside of it, so search_maze crosses it in a single move from one end to the other
+// when the path itself isn't printed (see PATH_LENGTH)
+//
+typedef struct {
+    uint32_t ends[2]; // Triangles at both ends, which aren't part of the chain
+    uint32_t firsts[2]; // Triangle of the chain next to ends[end]
+    uint32_t length; // Moves from one end to the other
+    uint8_t arrivals[2]; // Direction of the last move into ends[end]
+    uint8_t padding[2];
+} Corridor;
+
+// Start of a corridors sidecar, followed by rows*cols uint32_t labels and corridorCount Corridor entries
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t corridorCount;
+    int64_t sourceSize; // Size and modification time of the maze file the sidecar was built from
+    int64_t sourceModified;
+} CorridorsHeader;
+
+//
+// Corridors of a maze, arrays are either computed by corridors_build or mapped straight from a sidecar by corridors_load
+//
+typedef struct {
+    int rows;
+    int cols;
+    uint32_t corridorCount;
+    const uint32_t *labels; // labels[cellIndex] = corridor the triangle is part of, NO_CORRIDOR for the others
+    const Corridor *corridors; // corridors[label]
+    void *memory; // Arrays computed by corridors_build
+    FileView view; // Sidecar the arrays are mapped from
+    bool isLoaded;
+} Corridors;
+
+// Position and counters of a hand rule walk, shared between search_maze and its kernels
+typedef struct {
+    int r;
+    int c;
+    int64_t cellIndex; // Mazes on tiles may have more triangles than int can count
+    int heading; // Index into handOrder the current triangle was entered with
+    long long steps;
+    long long blockedProbes;
+    long long revisits;
+} Walk;
+
+//
+// Walks the hand rule from walk until the path leaves the maze, returns a SearchResult
+// Every move is a single lookup into transitionTable using the packed value of a cell (see map_pack_cells)
+// Only called with constant hand and countOnly, so that every kernel below gets its own copy without any branch on
+// them. countOnly kernels only count positions into sink and cross corridors (or NULL) in a single move
+//
+static inline __attribute__((always_inline)) int walk_maze(Map *map, const Corridors *corridors, SearchWorkspace *workspace,
+                                                           Walk *walk, PathSink *sink, const int hand, const bool countOnly)
+{
+    int r = walk->r, c = walk->c, heading = walk->heading;
+    int64_t cellIndex = walk->cellIndex;
+    long long steps = 0, blockedProbes = 0, revisits = 0, positions = 1;
+    bool countRevisits = MAZE_STATS && statsOutput;
+    int result = SEARCH_FOUND;
+
+    // Change of cellIndex for every Direction
+    const int64_t cellStep[NUM_OF_DIRECTIONS] = {0, -1, 1, -map->cols, map->cols};
+    const unsigned char (*transitions)[4] = transitionTable[hand];
+
+    // Heading a triangle is entered with after a move in Direction from a triangle of TriangleType
+    int arrivalHeading[2][NUM_OF_DIRECTIONS] = {{0}};
+    for(int type = CONTAINS_UP; type <= CONTAINS_DOWN; type++){
+        for(int index = 1; index < 4; index++){
+            arrivalHeading[type][handOrder[hand][type][index]] = index;
+        }
+    }
+
+    if(!countOnly){
+        path_sink_push(sink, r, c);
+    }
+    while(1){
+        unsigned entry = transitions[map_packed_cell(map, r, c, cellIndex)][heading];
+        if(entry == 0){
+            fprintf(stderr, "Error triangle %d,%d is closed from all sides\n", r, c);
+            result = SEARCH_ERROR;
+            break;
+        }
+        // Sides tried before the one the table picked, the table tries them in turn starting after heading
+        blockedProbes += ((entry & TRANSITION_HEADING_MASK) - heading + 2) % 3;
+        if(isolate_bit_value(entry, TRANSITION_EXIT_BIT)){
+            break;
+        }
+        // Costs a few more loads per move, so it's only done when the counters are printed
+        revisits += countRevisits && workspace_left_before(workspace, r, c, cellIndex);
+
+        heading = entry & TRANSITION_HEADING_MASK;
+        Direction direction = (entry >> TRANSITION_DIRECTION_SHIFT) & 0x07;
+
+        // Same triangle left through the same side again, the hand rule would repeat the same moves forever
+        int visited = workspace_visit(workspace, r, c, cellIndex, entry >> TRANSITION_SIDE_SHIFT);
+        if(visited == 1){
+            fprintf(stderr, "Error path goes around in circles and never leaves the maze\n");
+            result = SEARCH_LOOPED;
+            break;
+        } else if(visited == -1){
+            result = SEARCH_ERROR;
+            break;
+        }
+
+        if(maxSteps > 0 && steps == maxSteps){
+            fprintf(stderr, "Error path didn't leave the maze within %lld steps\n", maxSteps);
+            result = SEARCH_STEP_LIMIT;
+            break;
+        }
+
+        //
+        // A path entering a corridor always leaves through its other end, so no loop can start inside of it
+        // The first repeated move is always made outside of corridors, where it's still found by workspace_visit
+        //
+        uint32_t label = countOnly && corridors != NULL ? corridors->labels[cellIndex + cellStep[direction]] : NO_CORRIDOR;
+        if(label != NO_CORRIDOR){
+            const Corridor *corridor = &corridors->corridors[label];
+            uint32_t first = (uint32_t)(cellIndex + cellStep[direction]);
+            int end = first == corridor->firsts[0] && (first != corridor->firsts[1] || (uint32_t)cellIndex == corridor->ends[0]) ? 1 : 0;
+            if(maxSteps > 0 && steps + corridor->length > maxSteps){
+                positions += maxSteps - steps;
+                steps = maxSteps;
+                fprintf(stderr, "Error path didn't leave the maze within %lld steps\n", maxSteps);
+                result = SEARCH_STEP_LIMIT;
+                break;
+            }
+            positions += corridor->length;
+            steps += corridor->length;
+            cellIndex = corridor->ends[end];
+            r = (int)(cellIndex / map->cols) + 1;
+            c = (int)(cellIndex % map->cols) + 1;
+            // Last move was made from a triangle of the other type than the end
+            heading = arrivalHeading[(r + c) % 2 == 0 ? CONTAINS_DOWN : CONTAINS_UP][corridor->arrivals[end]];
+            continue;
+        }
+        steps++;
+
+        // Matches array indexes to Direction enum by -1 to account for it starting at L=1
+        cellIndex += cellStep[direction];
+        r += directionVector[direction-1].r;
+        c += directionVector[direction-1].c;
+        if(countOnly){
+            positions++;
+        } else {
+            path_sink_push(sink, r, c);
+        }
+    }
+    if(countOnly){
+        sink->positions += positions;
+    }
+    walk->steps = steps;
+    walk->blockedProbes = blockedProbes;
+    walk->revisits = revisits;
+    return result;
+}
+
+// Kernel of walk_maze for a single hand, printing the path or only counting its positions
+#define WALK_KERNEL(name, hand, countOnly) \
+    int name(Map *map, const Corridors *corridors, SearchWorkspace *workspace, Walk *walk, PathSink *sink) \
+    { \
+        return walk_maze(map, corridors, workspace, walk, sink, hand, countOnly); \
+    }
+
+WALK_KERNEL(walk_left, 0, false)
+WALK_KERNEL(walk_right, 1, false)
+WALK_KERNEL(walk_left_count, 0, true)
+WALK_KERNEL(walk_right_count, 1, true)
+
+// Kernels indexed by [hand][countOnly]
+int (*const walkKernels[2][2])(Map *, const Corridors *, SearchWorkspace *, Walk *, PathSink *) = {
+    {walk_left, walk_left_count},
+    {walk_right, walk_right_count},
+};
+
+//
+// Used for --rpath a --lpath, the path is pushed into sink
+// Returns a SearchResult, the search always ends because a path that starts to repeat itself is stopped
+// The walk itself is done by one of walkKernels, sinks of PATH_LENGTH use the corridors of a --corridors sidecar (or NULL)
+//
+int search_maze(Map *map, const Corridors *corridors, SearchWorkspace *workspace, int r, int c, int leftRight, PathSink *sink)
+{
+    if(r < 1 || c < 1 || r > map->rows || c > map->cols){
+        fprintf(stderr, "Error wrong args R and C -> position is outside of the maze\n");
+        return -1;
+    }
+
+    int hand = leftRight == R ? 1 : 0;
+    int heading = start_border(map, r, c, hand);
+    if(heading == -1){
+        return -1;
+    }
+
+    // Every triangle has a bit for each of its sides, set once the path leaves the triangle through that side
+    if(workspace_begin_walk(workspace, map) == -1){
+        return -1;
+    }
+    uint64_t started = STATS_NOW();
+    Walk walk = {.r = r, .c = c, .cellIndex = (int64_t)(r-1) * map->cols + (c-1), .heading = heading};
+    int result = walkKernels[hand][sink->format == PATH_LENGTH](map, corridors, workspace, &walk, sink);
+    workspace_end_walk(workspace);
+    STATS_ADD(steps, walk.steps);
+    STATS_ADD(blockedProbes, walk.blockedProbes);
+    STATS_ADD(revisits, walk.revisits);
+    STATS_ADD(searchNs, STATS_NOW() - started);
+    return result;
+}
+
+// Marks a side of a triangle inside Graph.links that can't be passed
+#define NO_LINK -1
+// Marks a side of a triangle inside Graph.links that leads outside of the maze
+#define EXIT_LINK -2
+
+// Precomputed neighbours of every triangle of a maze, used for --shortest
+typedef struct {
+    int cellCount;
+    const int *links; // links[cellIndex * NUM_OF_SIDES + side] = index of a neighbouring cell, NO_LINK or EXIT_LINK
+    int *memory; // Links computed by graph_ctor, NULL when they are mapped from a compiled maze
+} Graph;
+
+// Returns the link of a side, used for graph_ctor
+int determine_link(bool isBorder, bool isBoundary, int neighbourIndex)
+{
+    if(isBorder){
+        return NO_LINK;
+    }
+    return isBoundary ? EXIT_LINK : neighbourIndex;
+}
+
+//
+// Initializes Graph structure by walking Map.cells once, every triangle gets links to all neighbours it can move to
+// A compiled maze with a graph section already has them, they are used straight from the mapping
+//
+int graph_ctor(Graph **graph, Map *map)
+{
+    *graph = malloc(sizeof(Graph));
+    if(*graph == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return -1;
+    }
+
+    (*graph)->cellCount = map->rows * map->cols;
+    (*graph)->memory = NULL;
+    const TmazeSection *section = map->compiled != NULL ? tmaze_section(map->compiled, TMAZE_SECTION_GRAPH) : NULL;
+    if(section != NULL && section->size == sizeof(int) * NUM_OF_SIDES * (uint64_t)(*graph)->cellCount){
+        (*graph)->links = (const int *)(map->compiled->data + section->offset);
+        return 0;
+    }
+
+    int *links = malloc(sizeof(int) * NUM_OF_SIDES * (size_t)(*graph)->cellCount);
+    if(links == NULL){
+        fprintf(stderr, "Malloc failed on links\n");
+        free(*graph);
+        *graph = NULL;
+        return -1;
+    }
+    (*graph)->links = links;
+    (*graph)->memory = links;
+    for(int r = 1; r <= map->rows; r++){
+        for(int c = 1; c <= map->cols; c++){
+            int cellIndex = (r-1) * map->cols + (c-1);
+            unsigned cellValue = map_packed_cell(map, r, c, cellIndex);
+            Position pos = {r, c};
+
+            links[cellIndex*NUM_OF_SIDES + LEFT_SIDE] = determine_link(isolate_bit_value(cellValue, LEFT_BIT), c == 1, cellIndex - 1);
+            links[cellIndex*NUM_OF_SIDES + RIGHT_SIDE] = determine_link(isolate_bit_value(cellValue, RIGHT_BIT), c == map->cols, cellIndex + 1);
+
+            // Parity of the triangle decides whether the third side leads UP or DOWN
+            if(determine_triangle_type(pos) == CONTAINS_UP){
+                links[cellIndex*NUM_OF_SIDES + VERTICAL_SIDE] = determine_link(isolate_bit_value(cellValue, UPDOWN_BIT), r == 1, cellIndex - map->cols);
+            } else {
+                links[cellIndex*NUM_OF_SIDES + VERTICAL_SIDE] = determine_link(isolate_bit_value(cellValue, UPDOWN_BIT), r == map->rows, cellIndex + map->cols);
+            }
+        }
+    }
+    return 0;
+}
+
+// Destructor for Graph structure
+void graph_dtor(Graph **graph)
+{
+    if(graph != NULL && *graph != NULL){
+        free((*graph)->memory);
+        free(*graph);
+        *graph = NULL;
+    }
+}
+
+// Strategies of --shortest chosen by --search, all of them find paths of the same length
+typedef enum {
+    SEARCH_BFS, // Breadth-first search from the start
+    SEARCH_BIDIRECTIONAL, // Breadth-first searches from the start and from every exit meet in the middle
+    SEARCH_ASTAR, // A* towards the closest edge of the maze, skips the cells leading away from it
+} SearchStrategy;
+
+// Set by --search
+SearchStrategy searchStrategy = SEARCH_BFS;
+
+// Breadth-first search of shortest_path, *found becomes the closest exit, path to it leads through parent
+static int shortest_path_bfs(Graph *graph, SearchWorkspace *workspace, int startIndex, int *found, long long *expanded, long long *revisits)
+{
+    int cellCount = graph->cellCount;
+    unsigned generation = workspace->generation;
+    unsigned *stamp = workspace->stamp;
+    int *parent = workspace->parent;
+    int *queue = workspace->queue;
+    int queueHead = 0, queueCount = 0;
+
+    stamp[startIndex] = generation;
+    parent[startIndex] = startIndex;
+    queue[queueCount++] = startIndex;
+
+    while(queueCount > 0 && *found == -1){
+        int cellIndex = queue[queueHead];
+        queueHead = queueHead + 1 == cellCount ? 0 : queueHead + 1;
+        queueCount--;
+        (*expanded)++;
+
+        for(int side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+            int link = graph->links[cellIndex*NUM_OF_SIDES + side];
+            if(link == EXIT_LINK && cellIndex != startIndex){
+                *found = cellIndex;
+                break;
+            }
+            if(link >= 0 && stamp[link] != generation){
+                stamp[link] = generation;
+                parent[link] = cellIndex;
+                int queueTail = queueHead + queueCount;
+                queue[queueTail >= cellCount ? queueTail - cellCount : queueTail] = link;
+                queueCount++;
+            } else if(link >= 0){
+                (*revisits)++;
+            }
+        }
+    }
+    return 0;
+}
+
+// Returns true when a triangle has a side leading outside of the maze
+static inline bool graph_is_exit(Graph *graph, int cellIndex)
+{
+    const int *links = graph->links + (size_t)cellIndex * NUM_OF_SIDES;
+    return links[LEFT_SIDE] == EXIT_LINK || links[RIGHT_SIDE] == EXIT_LINK || links[VERTICAL_SIDE] == EXIT_LINK;
+}
+
+// Appends every exit of the maze but startIndex to exits, they only lie on the edge of the maze, returns -1 on failure
+static int graph_collect_exits(Map *map, Graph *graph, int startIndex, IndexList *exits)
+{
+    for(int r = 1; r <= map->rows; r++){
+        int step = r == 1 || r == map->rows || map->cols == 1 ? 1 : map->cols - 1;
+        for(int c = 1; c <= map->cols; c += step){
+            int cellIndex = (r-1) * map->cols + (c-1);
+            if(cellIndex != startIndex && graph_is_exit(graph, cellIndex) && index_list_push(exits, cellIndex) == -1){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Fills from[side] with the neighbour which leaves through side into cellIndex, -1 if there is none
+static inline void graph_predecessors(Map *map, Graph *graph, int cellIndex, int from[NUM_OF_SIDES])
+{
+    int rows = map->rows, cols = map->cols;
+    int r = cellIndex / cols + 1, c = cellIndex % cols + 1;
+    int vertical;
+    if(determine_triangle_type((Position){r, c}) == CONTAINS_UP){
+        vertical = r > 1 ? cellIndex - cols : -1;
+    } else {
+        vertical = r < rows ? cellIndex + cols : -1;
+    }
+    const int *links = graph->links;
+    from[LEFT_SIDE] = c < cols && links[(cellIndex + 1)*NUM_OF_SIDES + LEFT_SIDE] == cellIndex ? cellIndex + 1 : -1;
+    from[RIGHT_SIDE] = c > 1 && links[(cellIndex - 1)*NUM_OF_SIDES + RIGHT_SIDE] == cellIndex ? cellIndex - 1 : -1;
+    from[VERTICAL_SIDE] = vertical >= 0 && links[vertical*NUM_OF_SIDES + VERTICAL_SIDE] == cellIndex ? vertical : -1;
+}
+
+//
+// Bidirectional search of shortest_path, the reverse search starts from every exit and follows links backwards
+// Whole levels of the smaller frontier are expanded at a time, so the first cell reached by both searches lies on a shortest path
+// *found becomes that cell, path to it leads through parent and continues to an exit through otherParent
+//
+static int shortest_path_bidirectional(Map *map, Graph *graph, SearchWorkspace *workspace, int startIndex, int *found,
+                                       long long *expanded, long long *revisits)
+{
+    const int *links = graph->links;
+    unsigned generation = workspace->generation;
+    unsigned *stamp = workspace->stamp, *otherStamp = workspace->otherStamp;
+    int *parent = workspace->parent, *otherParent = workspace->otherParent;
+    IndexList *lists = workspace->lists;
+
+    stamp[startIndex] = generation;
+    parent[startIndex] = startIndex;
+    if(index_list_push(&lists[0], startIndex) == -1){
+        return -1;
+    }
+    if(graph_collect_exits(map, graph, startIndex, &lists[2]) == -1){
+        return -1;
+    }
+    for(size_t item = 0; item < lists[2].count; item++){
+        otherStamp[lists[2].items[item]] = generation;
+        otherParent[lists[2].items[item]] = lists[2].items[item];
+    }
+
+    while(lists[0].count > 0 && lists[2].count > 0 && *found == -1){
+        bool forward = lists[0].count <= lists[2].count;
+        IndexList *current = &lists[forward ? 0 : 2], *next = &lists[forward ? 1 : 3];
+        next->count = 0;
+        for(size_t item = 0; item < current->count && *found == -1; item++){
+            int cellIndex = current->items[item];
+            (*expanded)++;
+            if(forward){
+                for(int side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+                    int link = links[cellIndex*NUM_OF_SIDES + side];
+                    if(link < 0){
+                        continue;
+                    }
+                    if(stamp[link] == generation){
+                        (*revisits)++;
+                        continue;
+                    }
+                    stamp[link] = generation;
+                    parent[link] = cellIndex;
+                    if(otherStamp[link] == generation){
+                        *found = link;
+                        break;
+                    }
+                    if(index_list_push(next, link) == -1){
+                        return -1;
+                    }
+                }
+                continue;
+            }
+
+            int from[NUM_OF_SIDES];
+            graph_predecessors(map, graph, cellIndex, from);
+            for(int side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+                int neighbour = from[side];
+                if(neighbour < 0){
+                    continue;
+                }
+                if(otherStamp[neighbour] == generation){
+                    (*revisits)++;
+                    continue;
+                }
+                otherStamp[neighbour] = generation;
+                otherParent[neighbour] = cellIndex;
+                if(stamp[neighbour] == generation){
+                    *found = neighbour;
+                    break;
+                }
+                if(index_list_push(next, neighbour) == -1){
+                    return -1;
+                }
+            }
+        }
+        IndexList swap = *current;
+        *current = *next;
+        *next = swap;
+    }
+    return 0;
+}
+
+// Moves between two triangles of a maze without any borders, a vertical move has to alternate with a side move
+static inline int triangle_distance(int r, int c, int r2, int c2)
+{
+    int rowMoves = abs(r2 - r), sideMoves = abs(c2 - c);
+    if(rowMoves == 0){
+        return sideMoves;
+    }
+    // The first vertical move is free of a side move only when the triangle already points the right way
+    bool isUp = (r + c) % 2 == 0;
+    int alternating = rowMoves - (r2 < r ? isUp : !isUp);
+    if(alternating > sideMoves){
+        // Additional side moves come in pairs, one there and one back
+        sideMoves += (alternating - sideMoves + 1) & ~1;
+    }
+    return rowMoves + sideMoves;
+}
+
+// Number of exits up to which A* heads for the closest exit, more of them are replaced by the closest edge
+#define ASTAR_EXIT_LIMIT 16
+
+// Lower bound of moves from a cell to the closest of exits, or to the edge of the maze when exits is NULL
+static inline int astar_estimate(int rows, int cols, const IndexList *exits, int cellIndex)
+{
+    int r = cellIndex / cols + 1, c = cellIndex % cols + 1;
+    if(exits == NULL){
+        // Any column of the first or last row will do, so there are no side moves besides the alternating ones
+        bool isUp = (r + c) % 2 == 0;
+        int distance = c - 1 < cols - c ? c - 1 : cols - c;
+        int up = r == 1 ? 0 : 2 * (r - 1) - isUp;
+        int down = r == rows ? 0 : 2 * (rows - r) - !isUp;
+        distance = up < distance ? up : distance;
+        return down < distance ? down : distance;
+    }
+
+    int distance = INT_MAX;
+    for(size_t item = 0; item < exits->count; item++){
+        int exitIndex = exits->items[item];
+        int exitDistance = triangle_distance(r, c, exitIndex / cols + 1, exitIndex % cols + 1);
+        distance = exitDistance < distance ? exitDistance : distance;
+    }
+    return distance;
+}
+
+//
+// A* search of shortest_path, cells are expanded by the moves taken plus astar_estimate
+// That estimate never drops by more than a move per move, so every cell is closed with its shortest distance
+// Estimates of the open cells are at most 2 apart, a bucket per estimate modulo 3 replaces a heap
+// *found becomes the closest exit, path to it leads through parent
+//
+static int shortest_path_astar(Map *map, Graph *graph, SearchWorkspace *workspace, int startIndex, int *found,
+                               long long *expanded, long long *revisits)
+{
+    int rows = map->rows, cols = map->cols;
+    unsigned generation = workspace->generation;
+    unsigned *stamp = workspace->stamp, *closed = workspace->otherStamp;
+    int *parent = workspace->parent, *moves = workspace->otherParent;
+    IndexList *buckets = workspace->lists, *exits = &workspace->lists[3];
+
+    if(graph_collect_exits(map, graph, startIndex, exits) == -1){
+        return -1;
+    }
+    if(exits->count == 0){
+        return 0;
+    }
+    const IndexList *targets = exits->count <= ASTAR_EXIT_LIMIT ? exits : NULL;
+
+    stamp[startIndex] = generation;
+    parent[startIndex] = startIndex;
+    moves[startIndex] = 0;
+    int estimate = astar_estimate(rows, cols, targets, startIndex);
+    if(index_list_push(&buckets[estimate % 3], startIndex) == -1){
+        return -1;
+    }
+
+    while(*found == -1){
+        IndexList *bucket = &buckets[estimate % 3];
+        if(bucket->count == 0){
+            if(buckets[0].count == 0 && buckets[1].count == 0 && buckets[2].count == 0){
+                break;
+            }
+            estimate++;
+            continue;
+        }
+        // Last in first out prefers the cells furthest from the start among the ones with the same estimate
+        int cellIndex = bucket->items[--bucket->count];
+        if(closed[cellIndex] == generation){
+            continue;
+        }
+        closed[cellIndex] = generation;
+        (*expanded)++;
+        if(cellIndex != startIndex && graph_is_exit(graph, cellIndex)){
+            *found = cellIndex;
+            break;
+        }
+
+        for(int side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+            int link = graph->links[cellIndex*NUM_OF_SIDES + side];
+            if(link < 0){
+                continue;
+            }
+            if(stamp[link] == generation && moves[link] <= moves[cellIndex] + 1){
+                (*revisits)++;
+                continue;
+            }
+            stamp[link] = generation;
+            parent[link] = cellIndex;
+            moves[link] = moves[cellIndex] + 1;
+            int linkEstimate = moves[link] + astar_estimate(rows, cols, targets, link);
+            if(index_list_push(&buckets[linkEstimate % 3], link) == -1){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+//
+// Used for --shortest, search from r and c to the closest triangle with a side leading outside of the maze
+// Starting triangle itself isn't counted as an exit because the maze is entered through it, the path is pushed into sink
+// graph is only read, so one Graph can answer any number of searches
+//
+int shortest_path(Map *map, Graph *graph, SearchWorkspace *workspace, int r, int c, PathSink *sink)
+{
+    if(r < 1 || c < 1 || r > map->rows || c > map->cols){
+        fprintf(stderr, "Error wrong args R and C -> position is outside of the maze\n");
+        return SEARCH_ERROR;
+    }
+
+    if(workspace_begin_bfs(workspace, searchStrategy != SEARCH_BFS) == -1){
+        return SEARCH_ERROR;
+    }
+    uint64_t started = STATS_NOW();
+    long long expanded = 0, revisits = 0;
+    int startIndex = (r-1) * map->cols + (c-1);
+    int found = -1;
+    int result;
+    if(searchStrategy == SEARCH_BIDIRECTIONAL){
+        result = shortest_path_bidirectional(map, graph, workspace, startIndex, &found, &expanded, &revisits);
+    } else if(searchStrategy == SEARCH_ASTAR){
+        result = shortest_path_astar(map, graph, workspace, startIndex, &found, &expanded, &revisits);
+    } else {
+        result = shortest_path_bfs(graph, workspace, startIndex, &found, &expanded, &revisits);
+    }
+    STATS_ADD(expanded, expanded);
+    STATS_ADD(revisits, revisits);
+    STATS_ADD(searchNs, STATS_NOW() - started);
+
+    if(result == -1){
+        return SEARCH_ERROR;
+    }
+    if(found == -1){
+        fprintf(stderr, "Error path out of the maze doesn't exist\n");
+        return SEARCH_ERROR;
+    }
+
+    // Path is reconstructed backwards from found, queue isn't needed anymore so it's reused to store it
+    int *queue = workspace->queue;
+    int pathLength = 0;
+    for(int cellIndex = found; cellIndex != startIndex; cellIndex = workspace->parent[cellIndex]){
+        queue[pathLength++] = cellIndex;
+    }
+    queue[pathLength++] = startIndex;
+
+    for(int step = pathLength - 1; step >= 0; step--){
+        path_sink_push(sink, queue[step] / map->cols + 1, queue[step] % map->cols + 1);
+    }
+    // Bidirectional search ends in the middle, the rest of the path to an exit leads through otherParent
+    if(searchStrategy == SEARCH_BIDIRECTIONAL){
+        for(int cellIndex = found; workspace->otherParent[cellIndex] != cellIndex; ){
+            cellIndex = workspace->otherParent[cellIndex];
+            path_sink_push(sink, cellIndex / map->cols + 1, cellIndex % map->cols + 1);
+        }
+    }
+    return SEARCH_FOUND;
+}
+
+// Returns the packed value of cellIndex, see map_packed_cell
+static inline unsigned map_indexed_cell(Map *map, int cellIndex)
+{
+    return map_packed_cell(map, cellIndex / map->cols + 1, cellIndex % map->cols + 1, cellIndex);
+}
+
+// Returns the triangle sharing side with cellIndex whether there is a border or not, -1 if side lies on the maze boundary
+static inline int map_neighbour(Map *map, int cellIndex, Side side)
+{
+    int r = cellIndex / map->cols + 1, c = cellIndex % map->cols + 1;
+    if(side == LEFT_SIDE){
+        return c > 1 ? cellIndex - 1 : -1;
+    }
+    if(side == RIGHT_SIDE){
+        return c < map->cols ? cellIndex + 1 : -1;
+    }
+    if(determine_triangle_type((Position){r, c}) == CONTAINS_UP){
+        return r > 1 ? cellIndex - map->cols : -1;
+    }
+    return r < map->rows ? cellIndex + map->cols : -1;
+}
+
+// Returns the link of side like Graph.links does, used where the maze changes and links would get out of date
+static inline int map_link(Map *map, int cellIndex, Side side)
+{
+    unsigned cellValue = map_indexed_cell(map, cellIndex);
+    return determine_link(isolate_bit_value(cellValue, (BitIndex)side), isolate_bit_value(cellValue >> BOUNDARY_SHIFT, (BitIndex)side),
+                          map_neighbour(map, cellIndex, side));
+}
+
+// Returns true when a triangle has a side leading outside of the maze
+static inline bool map_is_exit(Map *map, int cellIndex)
+{
+    unsigned cellValue = map_indexed_cell(map, cellIndex);
+    return (cellValue >> BOUNDARY_SHIFT) & ~cellValue & BORDER_MASK;
+}
+
+// Sets or clears a single border of a MAP_STORAGE_BYTES or MAP_STORAGE_PLANES map, packed bits above it stay the same
+static inline void map_store_border(Map *map, int cellIndex, BitIndex bit, bool isBorder)
+{
+    if(map->storage == MAP_STORAGE_BYTES){
+        map->cells[cellIndex] = (unsigned char)((map->cells[cellIndex] & ~(1U << bit)) | (unsigned)isBorder << bit);
+        return;
+    }
+    int column = cellIndex % map->cols;
+    uint64_t *word = &map_plane_row(map, bit, cellIndex / map->cols + 1)[column / 64];
+    *word = (*word & ~(1ULL << (column % 64))) | (uint64_t)isBorder << (column % 64);
+}
+
+// Returns true if every side of cellIndex agrees with the neighbour sharing it, same rule as validator_push_row
+bool map_cell_consistent(Map *map, int cellIndex)
+{
+    unsigned cellValue = map_indexed_cell(map, cellIndex);
+    for(Side side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+        int neighbour = map_neighbour(map, cellIndex, side);
+        if(neighbour >= 0 && isolate_bit_value(cellValue, (BitIndex)side)
+                             != isolate_bit_value(map_indexed_cell(map, neighbour), (BitIndex)side_facing(side))){
+            return false;
+        }
+    }
+    return true;
+}
+
+// A change of --apply-patch, sets or clears the border on side of the triangle at r and c
+typedef struct {
+    int r;
+    int c;
+    Side side;
+    bool isBorder;
+} BorderPatch;
+
+// Names of Side values used in patch lines
+const char *sideNames[] = {"left", "right", "vertical"};
+
+//
+// Sets or clears the border of patch on its triangle and on the neighbour sharing it at once, so the maze stays valid
+// Only those two triangles are validated again, the rest of the maze can't have changed
+// Returns 1 if the maze changed, 0 if the border already was that way and -1 if the triangles don't agree afterwards
+// Position of patch has to lie inside of the maze and map can't be compiled or use MAP_STORAGE_TILES
+//
+int map_patch_border(Map *map, const BorderPatch *patch)
+{
+    int cellIndex = (patch->r-1) * map->cols + (patch->c-1);
+    if(isolate_bit_value(map_indexed_cell(map, cellIndex), (BitIndex)patch->side) == patch->isBorder){
+        return 0;
+    }
+
+    int neighbour = map_neighbour(map, cellIndex, patch->side);
+    map_store_border(map, cellIndex, (BitIndex)patch->side, patch->isBorder);
+    if(neighbour >= 0){
+        map_store_border(map, neighbour, (BitIndex)side_facing(patch->side), patch->isBorder);
+    }
+    STATS_ADD(cellsValidated, neighbour >= 0 ? 2 : 1);
+    if(!map_cell_consistent(map, cellIndex) || (neighbour >= 0 && !map_cell_consistent(map, neighbour))){
+        map->validity = MAZE_WRONG_BORDERS;
+        map->invalidRow = patch->r;
+        map->invalidCol = patch->c;
+        print_wrong_borders(patch->r, patch->c);
+        return -1;
+    }
+    return 1;
+}
+
+// Orders cell indexes for qsort
+int cell_index_compare(const void *first, const void *second)
+{
+    int firstIndex = *(const int *)first, secondIndex = *(const int *)second;
+    return firstIndex < secondIndex ? -1 : firstIndex > secondIndex;
+}
+
+//
+// Writes the borders of cells of map back into the text maze fileName in place, only the bytes of those cells are written
+// Every one of them has to be written as a single digit in the file, nothing is written otherwise. Returns -1 on failure
+//
+int map_write_cells(Map *map, const char *fileName, IndexList *cells)
+{
+    qsort(cells->items, cells->count, sizeof(int), cell_index_compare);
+    off_t *offsets = malloc(sizeof(off_t) * (cells->count + 1));
+    FileView view;
+    if(offsets == NULL || file_view_open(&view, fileName) == -1){
+        if(offsets == NULL){
+            fprintf(stderr, "Malloc failed\n");
+        }
+        free(offsets);
+        return -1;
+    }
+
+    // Cells are found the same way scan_row reads them, one number after another
+    const char *cursor = view.data;
+    int rows, cols, value;
+    size_t item = 0;
+    int result = scan_header(&cursor, view.end, &rows, &cols);
+    for(int cellIndex = 0; result == 0 && item < cells->count; cellIndex++){
+        while(cursor < view.end && (*cursor == ' ' || (*cursor >= '\t' && *cursor <= '\r'))){
+            cursor++;
+        }
+        const char *number = cursor;
+        if(scan_int(&cursor, view.end, &value) == -1){
+            fprintf(stderr, "Error reading row from file\n");
+            result = -1;
+        } else if(cells->items[item] == cellIndex){
+            if(cursor - number != 1){
+                fprintf(stderr, "Error cell %d,%d isn't a single digit, it can't be patched in place\n", cellIndex / cols + 1, cellIndex % cols + 1);
+                result = -1;
+            }
+            // Both triangles of a patch can be listed more than once
+            while(item < cells->count && cells->items[item] == cellIndex){
+                offsets[item++] = number - view.data;
+            }
+        }
+    }
+    file_view_close(&view);
+
+    int fd = result == 0 ? open(fileName, O_WRONLY) : -1;
+    if(result == 0 && fd == -1){
+        fprintf(stderr, "Error opening file\n");
+        result = -1;
+    }
+    for(item = 0; result == 0 && item < cells->count; item++){
+        char digit = (char)('0' + (map_indexed_cell(map, cells->items[item]) & BORDER_MASK));
+        if(pwrite(fd, &digit, 1, offsets[item]) != 1){
+            fprintf(stderr, "Error writing file\n");
+            result = -1;
+        }
+    }
+    if(fd != -1 && close(fd) == -1 && result == 0){
+        fprintf(stderr, "Error writing file\n");
+        result = -1;
+    }
+    free(offsets);
+    return result;
+}
+
+// Magic at the start of a sidecar written by --components and its format version
+#define COMPONENTS_MAGIC "TMAZECMP"
+#define COMPONENTS_VERSION 2
+// Ends the list of labels given up by components_patch
+#define NO_LABEL UINT32_MAX
+
+//
+// Summary of a single connected component
+// Both fields can be updated when triangles leave or join the component, see components_patch
+//
+typedef struct {
+    uint32_t exits; // Triangles with a side leading outside of the maze
+    uint32_t exitXor; // Cell indexes of those triangles xor'ed together, the index of the only one when exits == 1
+} ComponentInfo;
+
+// Start of a sidecar file, followed by rows*cols uint32_t labels and componentCount ComponentInfo entries
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t componentCount;
+    int64_t sourceSize; // Size and modification time of the maze file the sidecar was built from
+    int64_t sourceModified;
+} ComponentsHeader;
+
+//
+// Connected components of a maze, triangles are in the same component when a path leads between them
+// Arrays are either computed by components_build or mapped straight from a sidecar by components_load
+//
+typedef struct {
+    int rows;
+    int cols;
+    uint32_t componentCount;
+    const uint32_t *labels; // labels[cellIndex] = component of the triangle
+    const ComponentInfo *info; // info[label]
+    void *memory; // Arrays computed by components_build, room for a ComponentInfo per cell follows the labels
+    FileView view; // Sidecar the arrays are mapped from
+    bool isLoaded;
+    uint32_t *freeLabels; // Labels given up by components_patch, the last one is used again first
+    uint32_t freeLabelCount;
+    uint32_t freeLabelCapacity;
+} Components;
+
+// Returns the root of a union-find tree and halves the path to it on the way
+static inline int union_find_root(int *parent, int cellIndex)
+{
+    while(parent[cellIndex] != cellIndex){
+        parent[cellIndex] = parent[parent[cellIndex]];
+        cellIndex = parent[cellIndex];
+    }
+    return cellIndex;
+}
+
+// Joins the union-find trees of two cells, the lower root stays so that every root is the first cell of its component
+static inline void union_find_join(int *parent, int first, int second)
+{
+    first = union_find_root(parent, first);
+    second = union_find_root(parent, second);
+    if(first < second){
+        parent[second] = first;
+    } else {
+        parent[first] = second;
+    }
+}
+
+//
+// Labels the components of map with union-find over its borders, labels are numbered in the order of the file
+// Two triangles are joined only when both agree that their shared border is open, same as a valid maze always does
+//
+int components_build(Components *components, Map *map)
+{
+    int cellCount = map->rows * map->cols;
+    int *parent = malloc(sizeof(int) * (size_t)cellCount);
+    // Labels and at most one ComponentInfo per cell share a single allocation
+    void *memory = malloc((sizeof(uint32_t) + sizeof(ComponentInfo)) * (size_t)cellCount);
+    if(parent == NULL || memory == NULL){
+        fprintf(stderr, "Malloc failed on components\n");
+        free(parent);
+        free(memory);
+        return -1;
+    }
+    uint32_t *labels = memory;
+    ComponentInfo *info = (ComponentInfo *)(labels + cellCount);
+
+    for(int cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        parent[cellIndex] = cellIndex;
+    }
+    for(int r = 1; r <= map->rows; r++){
+        for(int c = 1; c <= map->cols; c++){
+            int cellIndex = (r-1) * map->cols + (c-1);
+            unsigned cellValue = map_packed_cell(map, r, c, cellIndex);
+            if(c < map->cols && !isolate_bit_value(cellValue, RIGHT_BIT)
+               && !isolate_bit_value(map_packed_cell(map, r, c+1, cellIndex+1), LEFT_BIT)){
+                union_find_join(parent, cellIndex, cellIndex + 1);
+            }
+            // Every UP/DOWN border is joined once, from the triangle above it
+            if(r < map->rows && isolate_bit_value(cellValue, ORIENTATION_BIT) && !isolate_bit_value(cellValue, UPDOWN_BIT)
+               && !isolate_bit_value(map_packed_cell(map, r+1, c, cellIndex + map->cols), UPDOWN_BIT)){
+                union_find_join(parent, cellIndex, cellIndex + map->cols);
+            }
+        }
+    }
+
+    uint32_t componentCount = 0;
+    for(int r = 1; r <= map->rows; r++){
+        for(int c = 1; c <= map->cols; c++){
+            int cellIndex = (r-1) * map->cols + (c-1);
+            int root = union_find_root(parent, cellIndex);
+            // Root is the first cell of its component, so it's always labeled before the rest
+            if(root == cellIndex){
+                info[componentCount].exits = 0;
+                info[componentCount].exitXor = 0;
+                labels[cellIndex] = componentCount++;
+            } else {
+                labels[cellIndex] = labels[root];
+            }
+
+            // Open side on the maze boundary, same as determine_maze_boundary
+            unsigned cellValue = map_packed_cell(map, r, c, cellIndex);
+            bool isExit = (cellValue >> BOUNDARY_SHIFT) & ~cellValue & BORDER_MASK;
+            ComponentInfo *component = &info[labels[cellIndex]];
+            if(isExit){
+                component->exits++;
+                component->exitXor ^= (uint32_t)cellIndex;
+            }
+        }
+    }
+    free(parent);
+
+    components->rows = map->rows;
+    components->cols = map->cols;
+    components->componentCount = componentCount;
+    components->labels = labels;
+    components->info = info;
+    components->memory = memory;
+    components->isLoaded = false;
+    components->freeLabels = NULL;
+    components->freeLabelCount = 0;
+    components->freeLabelCapacity = 0;
+    return 0;
+}
+
+// Returns the name of the sidecar of mazeFileName ending with suffix, has to be freed
+char *sidecar_name(const char *mazeFileName, const char *suffix)
+{
+    char *name = malloc(strlen(mazeFileName) + strlen(suffix) + 1);
+    if(name == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return NULL;
+    }
+    strcpy(name, mazeFileName);
+    strcat(name, suffix);
+    return name;
+}
+
+// Fills the size and modification time of the maze file a sidecar is built from, returns -1 if it can't be accessed
+int sidecar_source(const char *mazeFileName, int64_t *sourceSize, int64_t *sourceModified)
+{
+    struct stat fileInfo;
+    if(stat(mazeFileName, &fileInfo) == -1){
+        return -1;
+    }
+    *sourceSize = (int64_t)fileInfo.st_size;
+    *sourceModified = (int64_t)fileInfo.st_mtim.tv_sec * 1000000000 + fileInfo.st_mtim.tv_nsec;
+    return 0;
+}
+
+// Writes components of mazeFileName into its sidecar, returns -1 on failure
+int components_write(Components *components, const char *mazeFileName)
+{
+    ComponentsHeader header = {.version = COMPONENTS_VERSION, .rows = (uint32_t)components->rows,
+                               .cols = (uint32_t)components->cols, .componentCount = components->componentCount};
+    memcpy(header.magic, COMPONENTS_MAGIC, sizeof(header.magic));
+    if(sidecar_source(mazeFileName, &header.sourceSize, &header.sourceModified) == -1){
+        fprintf(stderr, "Error opening file\n");
+        return -1;
+    }
+
+    char *name = sidecar_name(mazeFileName, ".components");
+    if(name == NULL){
+        return -1;
+    }
+    FILE *file = fopen(name, "wb");
+    free(name);
+    if(file == NULL){
+        fprintf(stderr, "Error creating components file\n");
+        return -1;
+    }
+
+    size_t cellCount = (size_t)components->rows * components->cols;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(components->labels, sizeof(uint32_t), cellCount, file) == cellCount
+                && fwrite(components->info, sizeof(ComponentInfo), components->componentCount, file) == components->componentCount;
+    if(fclose(file) != 0 || !written){
+        fprintf(stderr, "Error writing components file\n");
+        return -1;
+    }
+    return 0;
+}
+
+//
+// Maps the sidecar of mazeFileName, the maze itself isn't read at all
+// Returns -1 without any message if there is no sidecar or it doesn't belong to the current maze file
+//
+int components_load(Components *components, const char *mazeFileName)
+{
+    ComponentsHeader source;
+    char *name = sidecar_name(mazeFileName, ".components");
+    if(name == NULL || sidecar_source(mazeFileName, &source.sourceSize, &source.sourceModified) == -1 || access(name, R_OK) == -1
+       || file_view_open(&components->view, name) == -1){
+        free(name);
+        return -1;
+    }
+    free(name);
+
+    ComponentsHeader header;
+    size_t size = components->view.size;
+    if(size >= sizeof(header)){
+        memcpy(&header, components->view.data, sizeof(header));
+    }
+    size_t cellCount = size >= sizeof(header) ? (size_t)header.rows * header.cols : 0;
+    if(size < sizeof(header) || memcmp(header.magic, COMPONENTS_MAGIC, sizeof(header.magic)) != 0
+       || header.version != COMPONENTS_VERSION || header.sourceSize != source.sourceSize
+       || header.sourceModified != source.sourceModified
+       || size != sizeof(header) + cellCount * sizeof(uint32_t) + header.componentCount * sizeof(ComponentInfo)){
+        verbose_error("Components file of %s is out of date\n", mazeFileName);
+        file_view_close(&components->view);
+        return -1;
+    }
+
+    components->rows = (int)header.rows;
+    components->cols = (int)header.cols;
+    components->componentCount = header.componentCount;
+    components->labels = (const uint32_t *)(components->view.data + sizeof(header));
+    components->info = (const ComponentInfo *)(components->labels + cellCount);
+    components->memory = NULL;
+    components->isLoaded = true;
+    components->freeLabels = NULL;
+    components->freeLabelCount = 0;
+    components->freeLabelCapacity = 0;
+    return 0;
+}
+
+// Destructor for Components structure
+void components_dtor(Components *components)
+{
+    if(components->isLoaded){
+        file_view_close(&components->view);
+    }
+    free(components->memory);
+    free(components->freeLabels);
+    components->memory = NULL;
+    components->freeLabels = NULL;
+    components->freeLabelCount = 0;
+    components->isLoaded = false;
+}
+
+//
+// Returns the cell index of r and c, -1 if they are outside of the maze
+// or the label of the cell isn't a component, labels mapped from a file are only checked for the cells asked about
+//
+int components_cell(Components *components, int r, int c)
+{
+    if(r < 1 || c < 1 || r > components->rows || c > components->cols){
+        fprintf(stderr, "Error wrong args R and C -> position is outside of the maze\n");
+        return -1;
+    }
+    int cellIndex = (r-1) * components->cols + (c-1);
+    if(components->labels[cellIndex] >= components->componentCount){
+        fprintf(stderr, "Error components file is damaged\n");
+        return -1;
+    }
+    return cellIndex;
+}
+
+// Returns true if a triangle other than cellIndex leading outside of the maze can be reached from cellIndex, like --shortest
+bool components_viable(Components *components, int cellIndex)
+{
+    const ComponentInfo *component = &components->info[components->labels[cellIndex]];
+    return component->exits > 1 || (component->exits == 1 && component->exitXor != (uint32_t)cellIndex);
+}
+
+// Returns true if a path leads between two cells
+bool components_reachable(Components *components, int firstIndex, int secondIndex)
+{
+    return components->labels[firstIndex] == components->labels[secondIndex];
+}
+
+//
+// Copies components mapped by components_load into memory laid out like components_build does, so that they can be patched
+// Returns -1 on failure
+//
+int components_thaw(Components *components)
+{
+    size_t cellCount = (size_t)components->rows * components->cols;
+    if(!components->isLoaded){
+        return 0;
+    }
+    bool isDamaged = components->componentCount > cellCount;
+    for(size_t cellIndex = 0; cellIndex < cellCount && !isDamaged; cellIndex++){
+        isDamaged = components->labels[cellIndex] >= components->componentCount;
+    }
+    if(isDamaged){
+        fprintf(stderr, "Error components file is damaged\n");
+        return -1;
+    }
+    uint32_t *labels = malloc((sizeof(uint32_t) + sizeof(ComponentInfo)) * cellCount);
+    if(labels == NULL){
+        fprintf(stderr, "Malloc failed on components\n");
+        return -1;
+    }
+    memcpy(labels, components->labels, sizeof(uint32_t) * cellCount);
+    memcpy(labels + cellCount, components->info, sizeof(ComponentInfo) * components->componentCount);
+    file_view_close(&components->view);
+
+    components->labels = labels;
+    components->info = (const ComponentInfo *)(labels + cellCount);
+    components->memory = labels;
+    components->isLoaded = false;
+    return 0;
+}
+
+//
+// Searches from first and second at the same time a triangle each, a search only enters triangles with the label of its start
+// *exhausted becomes the search which ran out of triangles first, they are left in workspace->lists[*exhausted],
+// or -1 if the searches met. Either way it takes about as long as the smaller of the two parts. Returns -1 on failure
+//
+static int components_race(Components *components, Map *map, SearchWorkspace *workspace, int first, int second, int *exhausted)
+{
+    unsigned generation = workspace->generation;
+    unsigned *stamps[2] = {workspace->stamp, workspace->otherStamp};
+    IndexList *found[2] = {&workspace->lists[0], &workspace->lists[1]};
+    size_t heads[2] = {0, 0};
+    stamps[0][first] = generation;
+    stamps[1][second] = generation;
+    if(index_list_push(found[0], first) == -1 || index_list_push(found[1], second) == -1){
+        return -1;
+    }
+
+    *exhausted = -1;
+    for(int search = 0; ; search = !search){
+        if(heads[search] == found[search]->count){
+            *exhausted = search;
+            return 0;
+        }
+        int cellIndex = found[search]->items[heads[search]++];
+        for(Side side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+            int link = map_link(map, cellIndex, side);
+            if(link < 0 || stamps[search][link] == generation || components->labels[link] != components->labels[cellIndex]){
+                continue;
+            }
+            if(stamps[!search][link] == generation){
+                return 0;
+            }
+            stamps[search][link] = generation;
+            if(index_list_push(found[search], link) == -1){
+                return -1;
+            }
+        }
+    }
+}
+
+//
+// Keeps components of map up to date after map_patch_border changed side of cellIndex, wasExit is the triangle before it
+// Only the smaller of the two parts a patch joins or splits gets a new label, a label left without triangles
+// is given up and used again by the next split. Components have to be built or thawed, returns -1 on failure
+//
+int components_patch(Components *components, Map *map, SearchWorkspace *workspace, int cellIndex, Side side, bool wasExit)
+{
+    uint32_t *labels = components->memory;
+    ComponentInfo *info = (ComponentInfo *)(labels + (size_t)components->rows * components->cols);
+    int neighbour = map_neighbour(map, cellIndex, side);
+    if(neighbour < 0){
+        // A side on the maze boundary only decides whether the triangle is an exit
+        ComponentInfo *component = &info[labels[cellIndex]];
+        if(wasExit && !map_is_exit(map, cellIndex)){
+            component->exits--;
+            component->exitXor ^= (uint32_t)cellIndex;
+        } else if(!wasExit && map_is_exit(map, cellIndex)){
+            component->exits++;
+            component->exitXor ^= (uint32_t)cellIndex;
+        }
+        return 0;
+    }
+
+    bool isOpen = map_link(map, cellIndex, side) >= 0;
+    if(isOpen && labels[cellIndex] == labels[neighbour]){
+        return 0;
+    }
+    int exhausted;
+    if(workspace_begin_bfs(workspace, true) == -1 || components_race(components, map, workspace, cellIndex, neighbour, &exhausted) == -1){
+        return -1;
+    }
+    if(exhausted == -1){
+        // Another path still leads around the new border
+        return 0;
+    }
+
+    IndexList *part = &workspace->lists[exhausted];
+    uint32_t oldLabel = labels[part->items[0]];
+    uint32_t newLabel;
+    if(isOpen){
+        newLabel = labels[exhausted == 0 ? neighbour : cellIndex];
+    } else if(components->freeLabelCount > 0){
+        newLabel = components->freeLabels[--components->freeLabelCount];
+    } else {
+        newLabel = components->componentCount++;
+    }
+    if(!isOpen){
+        info[newLabel] = (ComponentInfo){0, 0};
+    }
+
+    ComponentInfo moved = {0, 0};
+    for(size_t item = 0; item < part->count; item++){
+        labels[part->items[item]] = newLabel;
+        if(map_is_exit(map, part->items[item])){
+            moved.exits++;
+            moved.exitXor ^= (uint32_t)part->items[item];
+        }
+    }
+    info[oldLabel].exits -= moved.exits;
+    info[oldLabel].exitXor ^= moved.exitXor;
+    info[newLabel].exits += moved.exits;
+    info[newLabel].exitXor ^= moved.exitXor;
+    if(isOpen){
+        // Every triangle and exit of oldLabel moved, so its ComponentInfo is left zeroed
+        if(components->freeLabelCount == components->freeLabelCapacity){
+            uint32_t capacity = components->freeLabelCapacity == 0 ? 16 : components->freeLabelCapacity * 2;
+            uint32_t *grown = realloc(components->freeLabels, sizeof(uint32_t) * capacity);
+            if(grown == NULL){
+                fprintf(stderr, "Malloc failed on components\n");
+                return -1;
+            }
+            components->freeLabels = grown;
+            components->freeLabelCapacity = capacity;
+        }
+        components->freeLabels[components->freeLabelCount++] = oldLabel;
+    }
+    return 0;
+}
+
+//
+// Numbers patched labels in the order of the file again and drops the ones given up by components_patch,
+// so they end up the same as components_build would label the patched maze. Returns -1 on failure
+//
+int components_compact(Components *components)
+{
+    size_t cellCount = (size_t)components->rows * components->cols;
+    uint32_t *labels = components->memory;
+    ComponentInfo *info = (ComponentInfo *)(labels + cellCount);
+    uint32_t *renumbered = malloc(sizeof(uint32_t) * components->componentCount);
+    ComponentInfo *previous = malloc(sizeof(ComponentInfo) * components->componentCount);
+    if(renumbered == NULL || previous == NULL){
+        fprintf(stderr, "Malloc failed on components\n");
+        free(renumbered);
+        free(previous);
+        return -1;
+    }
+    memset(renumbered, 0xFF, sizeof(uint32_t) * components->componentCount);
+    memcpy(previous, info, sizeof(ComponentInfo) * components->componentCount);
+
+    uint32_t componentCount = 0;
+    for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        uint32_t label = labels[cellIndex];
+        if(renumbered[label] == NO_LABEL){
+            renumbered[label] = componentCount;
+            info[componentCount++] = previous[label];
+        }
+        labels[cellIndex] = renumbered[label];
+    }
+    components->componentCount = componentCount;
+    components->freeLabelCount = 0;
+    free(renumbered);
+    free(previous);
+    return 0;
+}
+
+// Layout of TMAZE_SECTION_COMPONENTS, followed by rows*cols uint32_t labels and componentCount ComponentInfo entries
+typedef struct {
+    uint32_t componentCount;
+    uint32_t reserved;
+} TmazeComponents;
+
+//
+// Maps the components section of a compiled maze, nothing else is read
+// Returns -1 without any message if fileName isn't a compiled maze or was compiled without components
+//
+int components_load_tmaze(Components *components, const char *fileName)
+{
+    if(access(fileName, R_OK) == -1 || file_view_open(&components->view, fileName) == -1){
+        return -1;
+    }
+    FileView *view = &components->view;
+    const TmazeHeader *header = tmaze_is(view) ? tmaze_header(view) : NULL;
+    const TmazeSection *section = header != NULL ? tmaze_section(view, TMAZE_SECTION_COMPONENTS) : NULL;
+    const TmazeComponents *counts = section != NULL && section->size >= sizeof(TmazeComponents)
+                                  ? (const TmazeComponents *)(view->data + section->offset) : NULL;
+    size_t cellCount = header != NULL ? (size_t)header->rows * header->cols : 0;
+    if(counts == NULL || section->size != sizeof(TmazeComponents) + cellCount * sizeof(uint32_t)
+                                          + counts->componentCount * sizeof(ComponentInfo)){
+        file_view_close(view);
+        return -1;
+    }
+
+    components->rows = (int)header->rows;
+    components->cols = (int)header->cols;
+    components->componentCount = counts->componentCount;
+    components->labels = (const uint32_t *)(counts + 1);
+    components->info = (const ComponentInfo *)(components->labels + cellCount);
+    components->memory = NULL;
+    components->isLoaded = true;
+    components->freeLabels = NULL;
+    components->freeLabelCount = 0;
+    components->freeLabelCapacity = 0;
+    return 0;
+}
+
+//
+// Used for --viable and --reachable, takes components of fileName from the compiled maze or its sidecar if it's up to date
+// Otherwise the maze is loaded and labeled in memory, returns -1 on failure
+//
+int components_open(Components *components, const char *fileName)
+{
+    if(components_load_tmaze(components, fileName) == 0 || components_load(components, fileName) == 0){
+        return 0;
+    }
+    Map *map;
+    if(map_ctor(&map, fileName) == -1){
+        return -1;
+    }
+    int result = components_build(components, map);
+    map_dtor(&map);
+    return result;
+}
+
+// Magic at the start of a sidecar written by --distance-field and its format version
+#define DISTANCES_MAGIC "TMAZEDST"
+#define DISTANCES_VERSION 3
+// Distance of a triangle from which no exit can be reached, also its source
+#define DISTANCE_UNREACHABLE UINT32_MAX
+// Side stored in DistanceField.hops leading towards the closest exit and towards the closest other exit
+#define HOP_CLOSEST_SHIFT 0
+#define HOP_OTHER_SHIFT 2
+
+//
+// Start of a distances sidecar, followed by exitCount uint32_t cell indexes of exits, the sources of both slots
+// of every triangle as indexes into those exits of sourceBytes each and the hops of every triangle
+// Distances aren't saved, following the hops measures them again (see distance_field_measure)
+//
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t exitCount;
+    uint32_t sourceBytes; // 2 while there are less than UINT16_MAX exits, otherwise 4
+    uint32_t padding;
+    int64_t sourceSize; // Size and modification time of the maze file the sidecar was built from
+    int64_t sourceModified;
+} DistancesHeader;
+
+//
+// Moves from every triangle to its two closest exits, --shortest then just follows hops instead of searching
+// The second exit answers paths starting at an exit, which isn't counted as an exit of its own path
+// Slot 0 is the closest exit and slot 1 the closest other one, a path only needs the hops and sources of the slots
+// distance_field_build and distance_field_thaw keep every array in memory, so that distance_field_patch can change them
+// distance_field_load maps just the exits, sources and hops from a sidecar
+//
+typedef struct {
+    int rows;
+    int cols;
+    const uint8_t *hops; // Side towards each of the two exits + 1 at HOP_CLOSEST_SHIFT and HOP_OTHER_SHIFT, 0 if there isn't any
+    uint32_t *distance[2]; // distance[slot][cellIndex] = moves to the exit of the slot, 0 for an exit itself
+    uint32_t *source[2]; // source[slot][cellIndex] = cell index of the exit of the slot
+    const uint32_t *exits; // Cell indexes of exits in a mapped sidecar, in the order of cell indexes
+    uint32_t exitCount;
+    uint32_t sourceBytes;
+    const void *exitOrder[2]; // exitOrder[slot][cellIndex] = index of the exit of the slot into exits
+    void *memory; // Arrays computed by distance_field_build or distance_field_thaw
+    FileView view; // Sidecar the arrays are mapped from
+    bool isLoaded;
+} DistanceField;
+
+// Returns the cell index of the exit a slot of cellIndex leads to, DISTANCE_UNREACHABLE if there isn't any
+static inline uint32_t distance_field_source(const DistanceField *field, int slot, int cellIndex)
+{
+    if(!field->isLoaded){
+        return field->source[slot][cellIndex];
+    }
+    uint32_t order;
+    if(field->sourceBytes == sizeof(uint16_t)){
+        uint16_t narrow = ((const uint16_t *)field->exitOrder[slot])[cellIndex];
+        order = narrow == UINT16_MAX ? DISTANCE_UNREACHABLE : narrow;
+    } else {
+        order = ((const uint32_t *)field->exitOrder[slot])[cellIndex];
+    }
+    return order < field->exitCount ? field->exits[order] : DISTANCE_UNREACHABLE;
+}
+
+// Moves r and c through hop, returns the cell index they end up at, -1 if there is no hop or it leaves the maze
+static inline int distance_field_step(const DistanceField *field, int *r, int *c, unsigned hop)
+{
+    if(hop == 0){
+        return -1;
+    }
+    int side = (int)hop - 1;
+    if(side != VERTICAL_SIDE){
+        *c += side == LEFT_SIDE ? -1 : 1;
+    } else {
+        // Same rule as determine_triangle_type, an UP triangle has its vertical neighbour above it
+        *r += (*r + *c) % 2 == 0 ? -1 : 1;
+    }
+    return *r < 1 || *c < 1 || *r > field->rows || *c > field->cols ? -1 : (*r-1) * field->cols + (*c-1);
+}
+
+// Allocates the arrays of a field of rows x cols kept in memory, returns -1 on failure
+int distance_field_alloc(DistanceField *field, int rows, int cols)
+{
+    size_t cellCount = (size_t)rows * cols;
+    uint32_t *memory = malloc((sizeof(uint32_t) * 4 + 1) * cellCount);
+    if(memory == NULL){
+        fprintf(stderr, "Malloc failed on distance field\n");
+        return -1;
+    }
+    field->rows = rows;
+    field->cols = cols;
+    field->distance[0] = memory;
+    field->distance[1] = memory + cellCount;
+    field->source[0] = memory + 2 * cellCount;
+    field->source[1] = memory + 3 * cellCount;
+    field->hops = (const uint8_t *)(memory + 4 * cellCount);
+    field->memory = memory;
+    field->isLoaded = false;
+    return 0;
+}
+
+//
+// Used for --distance-field, a single breadth-first search of graph backwards from every exit at once
+// Every triangle keeps the first two different exits that reach it, so the queue holds at most two entries per triangle
+// queue entries are cellIndex * 2 + 1 for the second exit, which fits into uint32_t for any maze of at most INT_MAX cells
+//
+int distance_field_build(DistanceField *field, Map *map, Graph *graph)
+{
+    int cellCount = map->rows * map->cols;
+    uint32_t *queue = malloc(sizeof(uint32_t) * 2 * (size_t)cellCount);
+    IndexList exits = {NULL, 0, 0};
+    if(queue == NULL || graph_collect_exits(map, graph, -1, &exits) == -1){
+        fprintf(stderr, "Malloc failed on distance field\n");
+        free(queue);
+        free(exits.items);
+        return -1;
+    }
+    if(distance_field_alloc(field, map->rows, map->cols) == -1){
+        free(queue);
+        free(exits.items);
+        return -1;
+    }
+    uint32_t **distance = field->distance, **source = field->source;
+    uint8_t *hops = (uint8_t *)field->hops;
+    memset(field->memory, 0xFF, sizeof(uint32_t) * 4 * (size_t)cellCount);
+    memset(hops, 0, (size_t)cellCount);
+
+    size_t queueHead = 0, queueTail = 0;
+    for(size_t item = 0; item < exits.count; item++){
+        distance[0][exits.items[item]] = 0;
+        source[0][exits.items[item]] = (uint32_t)exits.items[item];
+        queue[queueTail++] = (uint32_t)exits.items[item] * 2;
+    }
+    free(exits.items);
+
+    while(queueHead < queueTail){
+        int cellIndex = (int)(queue[queueHead] / 2);
+        int slot = queue[queueHead++] % 2;
+        uint32_t exitIndex = source[slot][cellIndex];
+        uint32_t moves = distance[slot][cellIndex] + 1;
+
+        int from[NUM_OF_SIDES];
+        graph_predecessors(map, graph, cellIndex, from);
+        for(int side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+            int neighbour = from[side];
+            if(neighbour < 0){
+                continue;
+            }
+            if(distance[0][neighbour] == DISTANCE_UNREACHABLE){
+                distance[0][neighbour] = moves;
+                source[0][neighbour] = exitIndex;
+                hops[neighbour] |= (uint8_t)((side + 1) << HOP_CLOSEST_SHIFT);
+                queue[queueTail++] = (uint32_t)neighbour * 2;
+            } else if(source[0][neighbour] != exitIndex && distance[1][neighbour] == DISTANCE_UNREACHABLE){
+                distance[1][neighbour] = moves;
+                source[1][neighbour] = exitIndex;
+                hops[neighbour] |= (uint8_t)((side + 1) << HOP_OTHER_SHIFT);
+                queue[queueTail++] = (uint32_t)neighbour * 2 + 1;
+            }
+        }
+    }
+    free(queue);
+    return 0;
+}
+
+// Returns the index of exitIndex into the exits of a sidecar, exits are in ascending order
+static inline uint32_t distance_exit_order(const uint32_t *exits, uint32_t exitCount, uint32_t exitIndex)
+{
+    uint32_t low = 0, high = exitCount;
+    while(low < high){
+        uint32_t middle = low + (high - low) / 2;
+        if(exits[middle] < exitIndex){
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+//
+// Writes field of mazeFileName held in memory into its sidecar, returns -1 on failure
+// Sources become indexes into the list of exits, which are narrow enough for 2 bytes in all but the largest mazes
+//
+int distance_field_write(DistanceField *field, const char *mazeFileName)
+{
+    DistancesHeader header = {.version = DISTANCES_VERSION, .rows = (uint32_t)field->rows, .cols = (uint32_t)field->cols};
+    memcpy(header.magic, DISTANCES_MAGIC, sizeof(header.magic));
+    if(sidecar_source(mazeFileName, &header.sourceSize, &header.sourceModified) == -1){
+        fprintf(stderr, "Error opening file\n");
+        return -1;
+    }
+
+    size_t cellCount = (size_t)field->rows * field->cols;
+    for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        header.exitCount += field->source[0][cellIndex] == cellIndex;
+    }
+    header.sourceBytes = header.exitCount < UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t *exits = malloc(sizeof(uint32_t) * (header.exitCount + 1));
+    unsigned char *orders = malloc(header.sourceBytes * cellCount);
+    if(exits == NULL || orders == NULL){
+        fprintf(stderr, "Malloc failed on distance field\n");
+        free(exits);
+        free(orders);
+        return -1;
+    }
+    uint32_t exitCount = 0;
+    for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        if(field->source[0][cellIndex] == cellIndex){
+            exits[exitCount++] = (uint32_t)cellIndex;
+        }
+    }
+
+    char *name = sidecar_name(mazeFileName, ".distances");
+    FILE *file = name != NULL ? fopen(name, "wb") : NULL;
+    free(name);
+    if(file == NULL){
+        fprintf(stderr, "Error creating distances file\n");
+        free(exits);
+        free(orders);
+        return -1;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(exits, sizeof(uint32_t), exitCount, file) == exitCount;
+    for(int slot = 0; slot < 2 && written; slot++){
+        for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+            uint32_t exitIndex = field->source[slot][cellIndex];
+            uint32_t order = exitIndex == DISTANCE_UNREACHABLE ? DISTANCE_UNREACHABLE : distance_exit_order(exits, exitCount, exitIndex);
+            if(header.sourceBytes == sizeof(uint16_t)){
+                uint16_t narrow = (uint16_t)order;
+                memcpy(orders + cellIndex * sizeof(narrow), &narrow, sizeof(narrow));
+            } else {
+                memcpy(orders + cellIndex * sizeof(order), &order, sizeof(order));
+            }
+        }
+        written = fwrite(orders, header.sourceBytes, cellCount, file) == cellCount;
+    }
+    written = written && fwrite(field->hops, 1, cellCount, file) == cellCount;
+    free(exits);
+    free(orders);
+    if(fclose(file) != 0 || !written){
+        fprintf(stderr, "Error writing distances file\n");
+        return -1;
+    }
+    return 0;
+}
+
+//
+// Maps the distances sidecar of mazeFileName, the maze itself isn't read at all
+// Returns -1 without any message if there is no sidecar or it doesn't belong to the current maze file
+//
+int distance_field_load(DistanceField *field, const char *mazeFileName)
+{
+    DistancesHeader source;
+    char *name = sidecar_name(mazeFileName, ".distances");
+    if(name == NULL || sidecar_source(mazeFileName, &source.sourceSize, &source.sourceModified) == -1 || access(name, R_OK) == -1
+       || file_view_open(&field->view, name) == -1){
+        free(name);
+        return -1;
+    }
+    free(name);
+
+    DistancesHeader header;
+    size_t size = field->view.size;
+    if(size >= sizeof(header)){
+        memcpy(&header, field->view.data, sizeof(header));
+    }
+    size_t cellCount = size >= sizeof(header) ? (size_t)header.rows * header.cols : 0;
+    if(size < sizeof(header) || memcmp(header.magic, DISTANCES_MAGIC, sizeof(header.magic)) != 0
+       || header.version != DISTANCES_VERSION || header.sourceSize != source.sourceSize
+       || header.sourceModified != source.sourceModified || header.rows > INT_MAX || header.cols > INT_MAX
+       || (header.sourceBytes != sizeof(uint16_t) && header.sourceBytes != sizeof(uint32_t))
+       || size != sizeof(header) + sizeof(uint32_t) * (size_t)header.exitCount + (2 * header.sourceBytes + 1) * cellCount){
+        verbose_error("Distances file of %s is out of date\n", mazeFileName);
+        file_view_close(&field->view);
+        return -1;
+    }
+
+    const char *arrays = field->view.data + sizeof(header);
+    field->rows = (int)header.rows;
+    field->cols = (int)header.cols;
+    field->exits = (const uint32_t *)arrays;
+    field->exitCount = header.exitCount;
+    field->sourceBytes = header.sourceBytes;
+    arrays += sizeof(uint32_t) * (size_t)header.exitCount;
+    field->exitOrder[0] = arrays;
+    field->exitOrder[1] = arrays + header.sourceBytes * cellCount;
+    field->hops = (const uint8_t *)(arrays + 2 * header.sourceBytes * cellCount);
+    field->memory = NULL;
+    field->isLoaded = true;
+    return 0;
+}
+
+// Destructor for DistanceField structure
+void distance_field_dtor(DistanceField *field)
+{
+    if(field->isLoaded){
+        file_view_close(&field->view);
+    }
+    free(field->memory);
+    field->memory = NULL;
+    field->isLoaded = false;
+}
+
+//
+// Used for --shortest with a distances sidecar, follows hops from r and c to the closest exit without any search
+// A path starting at an exit follows the closest other exit at every triangle where the closest one is the start
+//
+int distance_field_path(DistanceField *field, int r, int c, PathSink *sink)
+{
+    if(r < 1 || c < 1 || r > field->rows || c > field->cols){
+        fprintf(stderr, "Error wrong args R and C -> position is outside of the maze\n");
+        return SEARCH_ERROR;
+    }
+
+    int cellIndex = (r-1) * field->cols + (c-1);
+    uint32_t start = distance_field_source(field, 0, cellIndex) == (uint32_t)cellIndex ? (uint32_t)cellIndex : DISTANCE_UNREACHABLE;
+    unsigned hop = (field->hops[cellIndex] >> (start == DISTANCE_UNREACHABLE ? HOP_CLOSEST_SHIFT : HOP_OTHER_SHIFT)) & 0x03;
+    if(hop == 0){
+        fprintf(stderr, "Error path out of the maze doesn't exist\n");
+        return SEARCH_ERROR;
+    }
+
+    uint64_t started = STATS_NOW();
+    long long steps = 0, cellCount = (long long)field->rows * field->cols;
+    path_sink_push(sink, r, c);
+    while(hop != 0){
+        cellIndex = distance_field_step(field, &r, &c, hop);
+        // Hops of a field written by --distance-field never leave the maze or go around in circles
+        if(++steps == cellCount || cellIndex < 0){
+            fprintf(stderr, "Error distances file is damaged\n");
+            return SEARCH_ERROR;
+        }
+        path_sink_push(sink, r, c);
+        bool towardsStart = distance_field_source(field, 0, cellIndex) == start;
+        hop = (field->hops[cellIndex] >> (towardsStart ? HOP_OTHER_SHIFT : HOP_CLOSEST_SHIFT)) & 0x03;
+    }
+    STATS_ADD(steps, steps);
+    STATS_ADD(searchNs, STATS_NOW() - started);
+    return SEARCH_FOUND;
+}
+
+// Shifts of the hops of both slots inside DistanceField.hops
+const int hopShifts[2] = {HOP_CLOSEST_SHIFT, HOP_OTHER_SHIFT};
+
+//
+// Fills the distances of a thawed field, a hop of a slot leads into a triangle with a slot of the same exit
+// one move closer to it. Chains of hops are followed until a known distance and the moves are counted on the way back
+// Returns -1 if hops lead out of the maze, to another exit or around in circles
+//
+int distance_field_measure(DistanceField *field)
+{
+    size_t cellCount = (size_t)field->rows * field->cols;
+    uint32_t *chain = malloc(sizeof(uint32_t) * 2 * cellCount);
+    if(chain == NULL){
+        fprintf(stderr, "Malloc failed on distance field\n");
+        return -1;
+    }
+    for(int slot = 0; slot < 2; slot++){
+        for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+            field->distance[slot][cellIndex] = slot == 0 && field->source[0][cellIndex] == cellIndex ? 0 : DISTANCE_UNREACHABLE;
+        }
+    }
+
+    // Chain entries are cellIndex * 2 + slot
+    uint32_t entry = 0;
+    for(int startR = 1; startR <= field->rows; startR++){
+        for(int startC = 1; startC <= field->cols; startC++, entry += 2){
+            for(uint32_t current = entry; current < entry + 2; current++){
+                size_t length = 0;
+                uint32_t moves = DISTANCE_UNREACHABLE, link = current;
+                int r = startR, c = startC;
+                while(length < 2 * cellCount){
+                    int cellIndex = (int)(link / 2), slot = link % 2;
+                    uint32_t exitIndex = field->source[slot][cellIndex];
+                    if(exitIndex == DISTANCE_UNREACHABLE || field->distance[slot][cellIndex] != DISTANCE_UNREACHABLE){
+                        moves = field->distance[slot][cellIndex];
+                        break;
+                    }
+                    chain[length++] = link;
+                    int next = distance_field_step(field, &r, &c, (field->hops[cellIndex] >> hopShifts[slot]) & 0x03);
+                    if(next < 0){
+                        break;
+                    }
+                    link = (uint32_t)next * 2 + (field->source[0][next] == exitIndex ? 0 : 1);
+                    if(field->source[link % 2][next] != exitIndex){
+                        break;
+                    }
+                }
+                if(length > 0 && moves == DISTANCE_UNREACHABLE){
+                    fprintf(stderr, "Error distances file is damaged\n");
+                    free(chain);
+                    return -1;
+                }
+                while(length > 0){
+                    link = chain[--length];
+                    field->distance[link % 2][link / 2] = ++moves;
+                }
+            }
+        }
+    }
+    free(chain);
+    return 0;
+}
+
+// Copies a field mapped by distance_field_load into memory and measures its distances, so that it can be patched
+int distance_field_thaw(DistanceField *field)
+{
+    if(!field->isLoaded){
+        return 0;
+    }
+    DistanceField mapped = *field;
+    if(distance_field_alloc(field, mapped.rows, mapped.cols) == -1){
+        *field = mapped;
+        return -1;
+    }
+    size_t cellCount = (size_t)field->rows * field->cols;
+    for(int slot = 0; slot < 2; slot++){
+        for(size_t cellIndex = 0; cellIndex < cellCount; cellIndex++){
+            field->source[slot][cellIndex] = distance_field_source(&mapped, slot, (int)cellIndex);
+        }
+    }
+    memcpy((uint8_t *)field->hops, mapped.hops, cellCount);
+    file_view_close(&mapped.view);
+    return distance_field_measure(field);
+}
+
+// Writable arrays of a field kept in memory, slot 0 is the closest exit and slot 1 the closest other one
+typedef struct {
+    uint32_t *distance[2];
+    uint32_t *source[2];
+    uint8_t *hops;
+} DistanceSlots;
+
+// Points slots at the arrays of a field held in memory
+void distance_slots_ctor(DistanceSlots *slots, DistanceField *field)
+{
+    for(int slot = 0; slot < 2; slot++){
+        slots->distance[slot] = field->distance[slot];
+        slots->source[slot] = field->source[slot];
+    }
+    slots->hops = (uint8_t *)field->hops;
+}
+
+// Returns the side + 1 a slot of cellIndex leaves through, 0 if there isn't any
+static inline unsigned distance_slots_hop(DistanceSlots *slots, int slot, int cellIndex)
+{
+    return (slots->hops[cellIndex] >> hopShifts[slot]) & 0x03;
+}
+
+// Stores moves to exitIndex leaving through hop into a slot of cellIndex
+static inline void distance_slots_store(DistanceSlots *slots, int slot, int cellIndex, uint32_t moves, uint32_t exitIndex, unsigned hop)
+{
+    slots->distance[slot][cellIndex] = moves;
+    slots->source[slot][cellIndex] = exitIndex;
+    slots->hops[cellIndex] = (uint8_t)((slots->hops[cellIndex] & ~(0x03U << hopShifts[slot])) | hop << hopShifts[slot]);
+}
+
+//
+// Offers moves to exitIndex leaving cellIndex through hop, the two closest distinct exits are kept
+// Returns the slot which took the offer, -1 if both of them are at least as close
+//
+static int distance_slots_offer(DistanceSlots *slots, int cellIndex, uint32_t exitIndex, uint32_t moves, unsigned hop)
+{
+    uint32_t closest = slots->distance[0][cellIndex];
+    uint32_t closestExit = slots->source[0][cellIndex];
+    if(exitIndex == closestExit){
+        if(moves >= closest){
+            return -1;
+        }
+    } else if(moves < closest){
+        // Closest exit so far becomes the closest other one
+        distance_slots_store(slots, 1, cellIndex, closest, closestExit, distance_slots_hop(slots, 0, cellIndex));
+    } else {
+        if(moves >= slots->distance[1][cellIndex]){
+            return -1;
+        }
+        distance_slots_store(slots, 1, cellIndex, moves, exitIndex, hop);
+        return 1;
+    }
+    distance_slots_store(slots, 0, cellIndex, moves, exitIndex, hop);
+    return 0;
+}
+
+// Path from a triangle to an exit measured around the triangles distance_field_patch measures again
+typedef struct {
+    uint32_t moves;
+    uint32_t exitIndex;
+    int cellIndex;
+    unsigned hop;
+} DistanceOffer;
+
+// Orders DistanceOffers by moves for qsort
+int distance_offer_compare(const void *first, const void *second)
+{
+    uint32_t firstMoves = ((const DistanceOffer *)first)->moves, secondMoves = ((const DistanceOffer *)second)->moves;
+    return firstMoves < secondMoves ? -1 : firstMoves > secondMoves;
+}
+
+// Adds cellIndex to the triangles distance_field_patch measures again unless it's there already, returns -1 on failure
+static inline int distance_patch_mark(SearchWorkspace *workspace, int cellIndex)
+{
+    if(workspace->stamp[cellIndex] == workspace->generation){
+        return 0;
+    }
+    workspace->stamp[cellIndex] = workspace->generation;
+    return index_list_push(&workspace->lists[0], cellIndex);
+}
+
+//
+// Finds the triangles of distance_field_patch whose distances got shorter after side of cellIndex was opened,
+// improvements spread from the patch to every triangle leading into an improved one until nothing improves
+// They are added to workspace->lists[0], returns -1 on failure
+//
+static int distance_patch_improve(DistanceSlots *slots, Map *map, SearchWorkspace *workspace, int cellIndex, Side side, bool wasExit)
+{
+    unsigned generation = workspace->generation;
+    IndexList *queue = &workspace->lists[1];
+    DistanceOffer offers[2 * NUM_OF_SIDES + 1];
+    int offerCount = 0;
+    if(!wasExit && map_is_exit(map, cellIndex)){
+        offers[offerCount++] = (DistanceOffer){0, (uint32_t)cellIndex, cellIndex, 0};
+    }
+    int neighbour = map_link(map, cellIndex, side);
+    for(int slot = 0; slot < 2 && neighbour >= 0; slot++){
+        uint32_t moves = slots->distance[slot][neighbour];
+        if(moves != DISTANCE_UNREACHABLE){
+            offers[offerCount++] = (DistanceOffer){moves + 1, slots->source[slot][neighbour],
+                                                   cellIndex, side + 1};
+        }
+        moves = slots->distance[slot][cellIndex];
+        if(moves != DISTANCE_UNREACHABLE){
+            offers[offerCount++] = (DistanceOffer){moves + 1, slots->source[slot][cellIndex],
+                                                   neighbour, side_facing(side) + 1};
+        }
+    }
+
+    for(int offer = 0; offer < offerCount; offer++){
+        DistanceOffer *current = &offers[offer];
+        if(distance_slots_offer(slots, current->cellIndex, current->exitIndex, current->moves, current->hop) >= 0
+           && workspace->otherStamp[current->cellIndex] != generation){
+            workspace->otherStamp[current->cellIndex] = generation;
+            if(distance_patch_mark(workspace, current->cellIndex) == -1 || index_list_push(queue, current->cellIndex) == -1){
+                return -1;
+            }
+        }
+    }
+
+    // Improved triangles are queued once at a time, both of their slots are offered to every triangle leading into them
+    for(size_t head = 0; head < queue->count;){
+        int current = queue->items[head++];
+        workspace->otherStamp[current] = 0;
+        for(Side toSide = LEFT_SIDE; toSide < NUM_OF_SIDES; toSide++){
+            int from = map_link(map, current, toSide);
+            for(int slot = 0; slot < 2 && from >= 0; slot++){
+                uint32_t moves = slots->distance[slot][current];
+                if(moves == DISTANCE_UNREACHABLE
+                   || distance_slots_offer(slots, from, slots->source[slot][current],
+                                           moves + 1, side_facing(toSide) + 1) == -1
+                   || workspace->otherStamp[from] == generation){
+                    continue;
+                }
+                workspace->otherStamp[from] = generation;
+                if(distance_patch_mark(workspace, from) == -1 || index_list_push(queue, from) == -1){
+                    return -1;
+                }
+            }
+        }
+        if(head == queue->count){
+            head = 0;
+            queue->count = 0;
+        }
+    }
+    return 0;
+}
+
+//
+// Keeps field of map up to date after map_patch_border changed side of cellIndex, wasExit is the triangle before it
+// A border only takes paths away, the triangles whose hops lead through it are affected. An open side only adds paths,
+// the triangles that get closer to an exit are affected. So is every triangle whose hops lead into an affected one,
+// all of them are forgotten and measured again from the triangles around them, the rest of the field isn't touched
+// Field has to be built or thawed, returns -1 on failure
+//
+int distance_field_patch(DistanceField *field, Map *map, SearchWorkspace *workspace, int cellIndex, Side side, bool wasExit)
+{
+    DistanceSlots slots;
+    distance_slots_ctor(&slots, field);
+    if(workspace_begin_bfs(workspace, true) == -1){
+        return -1;
+    }
+    unsigned generation = workspace->generation;
+    IndexList *affected = &workspace->lists[0];
+    IndexList *queue = &workspace->lists[1];
+
+    if(map_link(map, cellIndex, side) == NO_LINK){
+        int neighbour = map_neighbour(map, cellIndex, side);
+        unsigned hop = side + 1, neighbourHop = side_facing(side) + 1;
+        if((wasExit && !map_is_exit(map, cellIndex)) || distance_slots_hop(&slots, 0, cellIndex) == hop
+           || distance_slots_hop(&slots, 1, cellIndex) == hop){
+            if(distance_patch_mark(workspace, cellIndex) == -1){
+                return -1;
+            }
+        }
+        if(neighbour >= 0 && (distance_slots_hop(&slots, 0, neighbour) == neighbourHop || distance_slots_hop(&slots, 1, neighbour) == neighbourHop)
+           && distance_patch_mark(workspace, neighbour) == -1){
+            return -1;
+        }
+    } else if(distance_patch_improve(&slots, map, workspace, cellIndex, side, wasExit) == -1){
+        return -1;
+    }
+
+    // Triangles with a hop into an affected one, list grows while it's walked through
+    for(size_t item = 0; item < affected->count; item++){
+        int current = affected->items[item];
+        for(Side toSide = LEFT_SIDE; toSide < NUM_OF_SIDES; toSide++){
+            int from = map_neighbour(map, current, toSide);
+            unsigned hop = side_facing(toSide) + 1;
+            if(from >= 0 && (distance_slots_hop(&slots, 0, from) == hop || distance_slots_hop(&slots, 1, from) == hop)
+               && distance_patch_mark(workspace, from) == -1){
+                return -1;
+            }
+        }
+    }
+    STATS_ADD(expanded, affected->count);
+    for(size_t item = 0; item < affected->count; item++){
+        distance_slots_store(&slots, 0, affected->items[item], DISTANCE_UNREACHABLE, DISTANCE_UNREACHABLE, 0);
+        distance_slots_store(&slots, 1, affected->items[item], DISTANCE_UNREACHABLE, DISTANCE_UNREACHABLE, 0);
+    }
+
+    // Paths into the rest of the field, an affected exit starts with itself
+    DistanceOffer *seeds = malloc(sizeof(DistanceOffer) * (2 * NUM_OF_SIDES + 1) * (affected->count + 1));
+    if(seeds == NULL){
+        fprintf(stderr, "Malloc failed on distance field\n");
+        return -1;
+    }
+    size_t seedCount = 0;
+    for(size_t item = 0; item < affected->count; item++){
+        int current = affected->items[item];
+        if(map_is_exit(map, current)){
+            seeds[seedCount++] = (DistanceOffer){0, (uint32_t)current, current, 0};
+        }
+        for(Side toSide = LEFT_SIDE; toSide < NUM_OF_SIDES; toSide++){
+            int to = map_link(map, current, toSide);
+            for(int slot = 0; slot < 2 && to >= 0 && workspace->stamp[to] != generation; slot++){
+                uint32_t moves = slots.distance[slot][to];
+                if(moves != DISTANCE_UNREACHABLE){
+                    seeds[seedCount++] = (DistanceOffer){moves + 1, slots.source[slot][to], current, toSide + 1};
+                }
+            }
+        }
+    }
+    qsort(seeds, seedCount, sizeof(DistanceOffer), distance_offer_compare);
+
+    //
+    // Same breadth-first search as distance_field_build inside of the affected triangles, sorted seeds are merged
+    // into its queue of (cell, slot) pairs so that every slot is taken in the order of moves and never changes again
+    //
+    queue->count = 0;
+    size_t head = 0, nextSeed = 0;
+    int result = 0;
+    while(result == 0 && (nextSeed < seedCount || head < queue->count)){
+        uint32_t queued = head < queue->count
+                        ? slots.distance[queue->items[head + 1]][queue->items[head]] + 1 : DISTANCE_UNREACHABLE;
+        if(nextSeed < seedCount && seeds[nextSeed].moves <= queued){
+            DistanceOffer *seed = &seeds[nextSeed++];
+            int slot = distance_slots_offer(&slots, seed->cellIndex, seed->exitIndex, seed->moves, seed->hop);
+            if(slot >= 0 && (index_list_push(queue, seed->cellIndex) == -1 || index_list_push(queue, slot) == -1)){
+                result = -1;
+            }
+            continue;
+        }
+
+        int current = queue->items[head], slot = queue->items[head + 1];
+        head += 2;
+        uint32_t exitIndex = slots.source[slot][current];
+        for(Side toSide = LEFT_SIDE; toSide < NUM_OF_SIDES && result == 0; toSide++){
+            int from = map_link(map, current, toSide);
+            if(from < 0 || workspace->stamp[from] != generation){
+                continue;
+            }
+            int taken = distance_slots_offer(&slots, from, exitIndex, queued, side_facing(toSide) + 1);
+            if(taken >= 0 && (index_list_push(queue, from) == -1 || index_list_push(queue, taken) == -1)){
+                result = -1;
+            }
+        }
+    }
+    free(seeds);
+    return result;
+}
+
+// Returns true for a packed cell of a triangle inside a corridor, see Corridor
+static inline bool corridor_cell(unsigned cellValue)
+{
+    unsigned open = ~cellValue & BORDER_MASK;
+    return open != BORDER_MASK && (open & (open - 1)) != 0 && ((cellValue >> BOUNDARY_SHIFT) & open) == 0;
+}
+
+// Returns the Direction of a move leaving cellIndex through side
+static inline Direction side_direction(Map *map, int cellIndex, Side side)
+{
+    if(side != VERTICAL_SIDE){
+        return side == LEFT_SIDE ? L : R;
+    }
+    Position pos = {cellIndex / map->cols + 1, cellIndex % map->cols + 1};
+    return determine_triangle_type(pos) == CONTAINS_UP ? U : D;
+}
+
+//
+// Used for --corridors, follows every chain of corridor triangles from the triangle before it to the one after it
+// Corridors are numbered in the order of the file by the first triangle leading into them, chains shorter than
+// CORRIDOR_MIN_LENGTH aren't kept. Borders of map have to be valid, a chain is followed only through its own sides
+//
+int corridors_build(Corridors *corridors, Map *map)
+{
+    int cellCount = map->rows * map->cols;
+    uint32_t *labels = malloc(sizeof(uint32_t) * (size_t)cellCount);
+    Corridor *found = NULL;
+    size_t capacity = 0;
+    uint32_t corridorCount = 0;
+    // Label of the triangles of chains that are too short, they become NO_CORRIDOR once all chains are followed
+    const uint32_t shortCorridor = NO_CORRIDOR - 1;
+    if(labels == NULL){
+        fprintf(stderr, "Malloc failed on corridors\n");
+        return -1;
+    }
+    memset(labels, 0xFF, sizeof(uint32_t) * (size_t)cellCount);
+
+    for(int cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        unsigned cellValue = map_indexed_cell(map, cellIndex);
+        if(corridor_cell(cellValue)){
+            continue;
+        }
+        for(Side side = LEFT_SIDE; side < NUM_OF_SIDES; side++){
+            if(isolate_bit_value(cellValue, (BitIndex)side) || isolate_bit_value(cellValue >> BOUNDARY_SHIFT, (BitIndex)side)){
+                continue;
+            }
+            int first = map_neighbour(map, cellIndex, side);
+            if(!corridor_cell(map_indexed_cell(map, first)) || labels[first] != NO_CORRIDOR){
+                continue;
+            }
+
+            if(corridorCount == capacity){
+                capacity = capacity == 0 ? 1024 : capacity * 2;
+                Corridor *grown = realloc(found, sizeof(Corridor) * capacity);
+                if(grown == NULL){
+                    fprintf(stderr, "Malloc failed on corridors\n");
+                    free(labels);
+                    free(found);
+                    return -1;
+                }
+                found = grown;
+            }
+
+            // Chain is left through the only open side besides the one it was entered through
+            int current = first, last = first;
+            Side leaving = side;
+            uint32_t length = 1;
+            while(corridor_cell(map_indexed_cell(map, current))){
+                labels[current] = corridorCount;
+                unsigned open = ~map_indexed_cell(map, current) & BORDER_MASK & ~(1U << side_facing(leaving));
+                leaving = open & (1U << LEFT_SIDE) ? LEFT_SIDE : open & (1U << RIGHT_SIDE) ? RIGHT_SIDE : VERTICAL_SIDE;
+                last = current;
+                current = map_neighbour(map, current, leaving);
+                length++;
+            }
+            if(length < CORRIDOR_MIN_LENGTH){
+                leaving = side;
+                for(current = first; labels[current] == corridorCount; current = map_neighbour(map, current, leaving)){
+                    labels[current] = shortCorridor;
+                    unsigned open = ~map_indexed_cell(map, current) & BORDER_MASK & ~(1U << side_facing(leaving));
+                    leaving = open & (1U << LEFT_SIDE) ? LEFT_SIDE : open & (1U << RIGHT_SIDE) ? RIGHT_SIDE : VERTICAL_SIDE;
+                }
+                continue;
+            }
+            found[corridorCount++] = (Corridor){
+                .ends = {(uint32_t)cellIndex, (uint32_t)current},
+                .firsts = {(uint32_t)first, (uint32_t)last},
+                .length = length,
+                .arrivals = {side_direction(map, first, side_facing(side)), side_direction(map, last, leaving)},
+            };
+        }
+    }
+
+    for(int cellIndex = 0; cellIndex < cellCount; cellIndex++){
+        labels[cellIndex] = labels[cellIndex] == shortCorridor ? NO_CORRIDOR : labels[cellIndex];
+    }
+
+    // Corridors follow the labels inside a single block, the same layout as the sidecar
+    size_t labelsSize = sizeof(uint32_t) * (size_t)cellCount;
+    void *memory = realloc(labels, labelsSize + sizeof(Corridor) * corridorCount);
+    if(memory == NULL){
+        fprintf(stderr, "Malloc failed on corridors\n");
+        free(labels);
+        free(found);
+        return -1;
+    }
+    if(corridorCount > 0){
+        memcpy((char *)memory + labelsSize, found, sizeof(Corridor) * corridorCount);
+    }
+    free(found);
+
+    corridors->rows = map->rows;
+    corridors->cols = map->cols;
+    corridors->corridorCount = corridorCount;
+    corridors->labels = memory;
+    corridors->corridors = (const Corridor *)((char *)memory + labelsSize);
+    corridors->memory = memory;
+    corridors->isLoaded = false;
+    return 0;
+}
+
+// Writes corridors of mazeFileName into its sidecar, returns -1 on failure
+int corridors_write(Corridors *corridors, const char *mazeFileName)
+{
+    CorridorsHeader header = {.version = CORRIDORS_VERSION, .rows = (uint32_t)corridors->rows,
+                              .cols = (uint32_t)corridors->cols, .corridorCount = corridors->corridorCount};
+    memcpy(header.magic, CORRIDORS_MAGIC, sizeof(header.magic));
+    if(sidecar_source(mazeFileName, &header.sourceSize, &header.sourceModified) == -1){
+        fprintf(stderr, "Error opening file\n");
+        return -1;
+    }
+
+    char *name = sidecar_name(mazeFileName, ".corridors");
+    if(name == NULL){
+        return -1;
+    }
+    FILE *file = fopen(name, "wb");
+    free(name);
+    if(file == NULL){
+        fprintf(stderr, "Error creating corridors file\n");
+        return -1;
+    }
+
+    size_t cellCount = (size_t)corridors->rows * corridors->cols;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(corridors->labels, sizeof(uint32_t), cellCount, file) == cellCount
+                && fwrite(corridors->corridors, sizeof(Corridor), corridors->corridorCount, file) == corridors->corridorCount;
+    if(fclose(file) != 0 || !written){
+        fprintf(stderr, "Error writing corridors file\n");
+        return -1;
+    }
+    return 0;
+}
+
+//
+// Maps the corridors sidecar of mazeFileName
+// Returns -1 without any message if there is no sidecar or it doesn't belong to the current maze file
+//
+int corridors_load(Corridors *corridors, const char *mazeFileName)
+{
+    CorridorsHeader source;
+    char *name = sidecar_name(mazeFileName, ".corridors");
+    if(name == NULL || sidecar_source(mazeFileName, &source.sourceSize, &source.sourceModified) == -1 || access(name, R_OK) == -1
+       || file_view_open(&corridors->view, name) == -1){
+        free(name);
+        return -1;
+    }
+    free(name);
+
+    CorridorsHeader header;
+    size_t size = corridors->view.size;
+    if(size >= sizeof(header)){
+        memcpy(&header, corridors->view.data, sizeof(header));
+    }
+    size_t cellCount = size >= sizeof(header) ? (size_t)header.rows * header.cols : 0;
+    if(size < sizeof(header) || memcmp(header.magic, CORRIDORS_MAGIC, sizeof(header.magic)) != 0
+       || header.version != CORRIDORS_VERSION || header.sourceSize != source.sourceSize
+       || header.sourceModified != source.sourceModified
+       || size != sizeof(header) + cellCount * sizeof(uint32_t) + header.corridorCount * sizeof(Corridor)){
+        verbose_error("Corridors file of %s is out of date\n", mazeFileName);
+        file_view_close(&corridors->view);
+        return -1;
+    }
+
+    corridors->rows = (int)header.rows;
+    corridors->cols = (int)header.cols;
+    corridors->corridorCount = header.corridorCount;
+    corridors->labels = (const uint32_t *)(corridors->view.data + sizeof(header));
+    corridors->corridors = (const Corridor *)(corridors->labels + cellCount);
+    corridors->memory = NULL;
+    corridors->isLoaded = true;
+    return 0;
+}
+
+// Destructor for Corridors structure
+void corridors_dtor(Corridors *corridors)
+{
+    if(corridors->isLoaded){
+        file_view_close(&corridors->view);
+    }
+    free(corridors->memory);
+    corridors->memory = NULL;
+    corridors->isLoaded = false;
+}
+
+// Loads the corridors sidecar of mazeFileName for search_maze on map, returns -1 if there is none for this maze
+int corridors_open(Corridors *corridors, Map *map, const char *mazeFileName)
+{
+    if(corridors_load(corridors, mazeFileName) == -1){
+        return -1;
+    }
+    if(corridors->rows != map->rows || corridors->cols != map->cols){
+        corridors_dtor(corridors);
+        return -1;
+    }
+    return 0;
+}
+
+// Set by --with-graph, --compile also stores Graph links so that --shortest doesn't build them
+bool compileGraph = false;
+
+// Writes zeros so that the next section starts at a TMAZE_ALIGNMENT boundary, returns false on failure
+bool tmaze_pad(FILE *file, uint64_t *offset)
+{
+    static const char zeros[TMAZE_ALIGNMENT];
+    size_t padding = (size_t)((TMAZE_ALIGNMENT - *offset % TMAZE_ALIGNMENT) % TMAZE_ALIGNMENT);
+    *offset += padding;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+// Writes packed cells of map row by row, planes are unpacked through map_packed_cell, returns the checksum through checksum
+bool tmaze_write_cells(FILE *file, Map *map, uint64_t *checksum)
+{
+    size_t cellCount = (size_t)map->rows * map->cols;
+    if(map->storage == MAP_STORAGE_BYTES){
+        *checksum = tmaze_checksum(map->cells, cellCount);
+        return fwrite(map->cells, 1, cellCount, file) == cellCount;
+    }
+
+    unsigned char *cells = malloc(cellCount);
+    if(cells == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return false;
+    }
+    for(int r = 1; r <= map->rows; r++){
+        for(int c = 1; c <= map->cols; c++){
+            int cellIndex = (r-1) * map->cols + (c-1);
+            cells[cellIndex] = (unsigned char)map_packed_cell(map, r, c, cellIndex);
+        }
+    }
+    *checksum = tmaze_checksum(cells, cellCount);
+    bool written = fwrite(cells, 1, cellCount, file) == cellCount;
+    free(cells);
+    return written;
+}
+
+//
+// Used for --compile, writes map with its components and, with --with-graph, its Graph links into outName
+// The header is written last, once the checksum of the cells is known
+//
+int tmaze_write(Map *map, Components *components, Graph *graph, const char *outName)
+{
+    FILE *file = fopen(outName, "wb");
+    if(file == NULL){
+        fprintf(stderr, "Error creating compiled maze\n");
+        return -1;
+    }
+
+    size_t cellCount = (size_t)map->rows * map->cols;
+    TmazeHeader header = {.version = TMAZE_VERSION, .byteOrder = TMAZE_BYTE_ORDER, .rows = (uint32_t)map->rows,
+                          .cols = (uint32_t)map->cols, .sectionCount = graph != NULL ? 3 : 2};
+    memcpy(header.magic, TMAZE_MAGIC, sizeof(header.magic));
+    if(map->validity == MAZE_VALID){
+        header.flags |= TMAZE_FLAG_VALID;
+    } else {
+        header.invalidRow = (uint32_t)map->invalidRow;
+        header.invalidCol = (uint32_t)map->invalidCol;
+    }
+
+    TmazeSection sections[3] = {
+        {.kind = TMAZE_SECTION_CELLS, .size = cellCount},
+        {.kind = TMAZE_SECTION_COMPONENTS, .size = sizeof(TmazeComponents) + cellCount * sizeof(uint32_t)
+                                                   + components->componentCount * sizeof(ComponentInfo)},
+        {.kind = TMAZE_SECTION_GRAPH, .size = cellCount * NUM_OF_SIDES * sizeof(int)},
+    };
+    uint64_t offset = sizeof(header) + header.sectionCount * sizeof(TmazeSection);
+    for(uint32_t sectionIndex = 0; sectionIndex < header.sectionCount; sectionIndex++){
+        offset += (TMAZE_ALIGNMENT - offset % TMAZE_ALIGNMENT) % TMAZE_ALIGNMENT;
+        sections[sectionIndex].offset = offset;
+        offset += sections[sectionIndex].size;
+    }
+
+    TmazeComponents counts = {.componentCount = components->componentCount};
+    offset = sizeof(header) + header.sectionCount * sizeof(TmazeSection);
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(sections, sizeof(TmazeSection), header.sectionCount, file) == header.sectionCount
+                && tmaze_pad(file, &offset) && tmaze_write_cells(file, map, &header.checksum);
+    offset += cellCount;
+    written = written && tmaze_pad(file, &offset)
+           && fwrite(&counts, sizeof(counts), 1, file) == 1
+           && fwrite(components->labels, sizeof(uint32_t), cellCount, file) == cellCount
+           && fwrite(components->info, sizeof(ComponentInfo), components->componentCount, file) == components->componentCount;
+    offset += sections[1].size;
+    if(graph != NULL){
+        written = written && tmaze_pad(file, &offset)
+               && fwrite(graph->links, sizeof(int) * NUM_OF_SIDES, cellCount, file) == cellCount;
+    }
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    if(fclose(file) != 0 || !written){
+        fprintf(stderr, "Error writing compiled maze\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Set by --threads, number of threads used by modes which can split their work
+int threadCount = 1;
+
+// Function running a single task of a WorkerPool, workerIndex identifies the thread running it
+typedef void (*TaskFunction)(void *context, int taskIndex, int workerIndex);
+
+// Tasks owned by a single worker, the owner takes them from head and other workers steal them from tail
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;
+    int head;
+    int tail;
+} TaskDeque;
+
+struct WorkerPool;
+
+// Argument of a worker thread
+typedef struct {
+    struct WorkerPool *pool;
+    int workerIndex;
+} Worker;
+
+//
+// Runs taskCount independent tasks on workerCount threads
+// Tasks are dealt round robin so that every worker starts with the lowest task indexes, a worker which runs out of
+// its own tasks steals half of the remaining tasks of another worker, which keeps all threads busy even when the
+// tasks take very different amounts of time
+//
+typedef struct WorkerPool {
+    int workerCount;
+    int startedCount; // Threads which were actually created
+    TaskDeque *deques;
+    Worker *workers;
+    pthread_t *threads;
+    TaskFunction function;
+    void *context;
+} WorkerPool;
+
+// Takes the next task of workerIndex or steals one from another worker, returns -1 once all tasks are taken
+int worker_pool_next_task(WorkerPool *pool, int workerIndex)
+{
+    TaskDeque *own = &pool->deques[workerIndex];
+
+    pthread_mutex_lock(&own->lock);
+    int task = own->head < own->tail ? own->tasks[own->head++] : -1;
+    pthread_mutex_unlock(&own->lock);
+    if(task != -1){
+        return task;
+    }
+
+    for(int offset = 1; offset < pool->workerCount; offset++){
+        TaskDeque *victim = &pool->deques[(workerIndex + offset) % pool->workerCount];
+
+        // Own deque is empty so nobody else can take from it, stolen tasks are copied without holding both locks
+        pthread_mutex_lock(&victim->lock);
+        int stolenCount = (victim->tail - victim->head + 1) / 2;
+        victim->tail -= stolenCount;
+        memcpy(own->tasks, victim->tasks + victim->tail, sizeof(int) * stolenCount);
+        pthread_mutex_unlock(&victim->lock);
+
+        pthread_mutex_lock(&own->lock);
+        own->head = 0;
+        own->tail = stolenCount;
+        task = stolenCount > 0 ? own->tasks[own->head++] : -1;
+        pthread_mutex_unlock(&own->lock);
+        if(task != -1){
+            return task;
+        }
+    }
+    return -1;
+}
+
+// Main function of a worker thread
+void *worker_run(void *arg)
+{
+    Worker *worker = arg;
+    WorkerPool *pool = worker->pool;
+
+    int task;
+    while((task = worker_pool_next_task(pool, worker->workerIndex)) != -1){
+        pool->function(pool->context, task, worker->workerIndex);
+    }
+    return NULL;
+}
+
+// Deals tasks to workerCount workers and starts them, finished with worker_pool_join
+int worker_pool_start(WorkerPool *pool, int workerCount, int taskCount, TaskFunction function, void *context)
+{
+    pool->workerCount = workerCount;
+    pool->function = function;
+    pool->context = context;
+    pool->deques = calloc(workerCount, sizeof(TaskDeque));
+    pool->workers = malloc(sizeof(Worker) * workerCount);
+    pool->threads = malloc(sizeof(pthread_t) * workerCount);
+    // Every deque can hold the largest initial share, a thief only steals into its own empty deque
+    int dequeCapacity = taskCount / workerCount + 1;
+    int *taskStorage = malloc(sizeof(int) * (size_t)dequeCapacity * workerCount);
+    if(pool->deques == NULL || pool->workers == NULL || pool->threads == NULL || taskStorage == NULL){
+        fprintf(stderr, "Malloc failed on worker pool\n");
+        free(pool->deques);
+        free(pool->workers);
+        free(pool->threads);
+        free(taskStorage);
+        return -1;
+    }
+
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        TaskDeque *deque = &pool->deques[workerIndex];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->tasks = taskStorage + (size_t)workerIndex * dequeCapacity;
+        for(int task = workerIndex; task < taskCount; task += workerCount){
+            deque->tasks[deque->tail++] = task;
+        }
+    }
+
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        pool->workers[workerIndex].pool = pool;
+        pool->workers[workerIndex].workerIndex = workerIndex;
+    }
+
+    // Workers which did start steal the tasks of the ones which didn't
+    pool->startedCount = 0;
+    while(pool->startedCount < workerCount){
+        if(pthread_create(&pool->threads[pool->startedCount], NULL, worker_run, &pool->workers[pool->startedCount]) != 0){
+            break;
+        }
+        pool->startedCount++;
+    }
+    if(pool->startedCount == 0){
+        fprintf(stderr, "Error creating threads, running tasks on the main thread\n");
+        worker_run(&pool->workers[0]);
+    }
+    return 0;
+}
+
+// Waits until all tasks of pool are finished and releases it
+void worker_pool_join(WorkerPool *pool)
+{
+    for(int workerIndex = 0; workerIndex < pool->startedCount; workerIndex++){
+        pthread_join(pool->threads[workerIndex], NULL);
+    }
+    for(int workerIndex = 0; workerIndex < pool->workerCount; workerIndex++){
+        pthread_mutex_destroy(&pool->deques[workerIndex].lock);
+    }
+    free(pool->deques[0].tasks);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+}
+
+// Runs taskCount tasks on workerCount threads and waits until all of them are finished
+int worker_pool_run(int workerCount, int taskCount, TaskFunction function, void *context)
+{
+    WorkerPool pool;
+    if(worker_pool_start(&pool, workerCount, taskCount, function, context) == -1){
+        return -1;
+    }
+    worker_pool_join(&pool);
+    return 0;
+}
+
+#ifndef TEST_CHUNK_MIN_BYTES
+// Smallest part of a maze file worth validating on its own thread
+#define TEST_CHUNK_MIN_BYTES (1 << 20)
+#endif
+// Chunks of a file per thread, more chunks than threads let the faster threads take over the rest
+#define TEST_CHUNKS_PER_THREAD 4
+// Returned by test_parallel when the file has to be validated by a single thread
+#define TEST_SERIAL 1
+
+//
+// Part of a maze file validated by test_parallel, the chunk of text starts at whitespace so that no number is split
+// Rows whose first cell lies inside the chunk make up its band
+//
+typedef struct {
+    const char *start;
+    const char *end;
+    long long numbers; // Numbers inside the chunk, -1 if it holds anything else than digits and whitespace
+    long long numbersBefore; // Numbers inside all previous chunks
+    bool failed; // Band couldn't be validated at all
+    int rowResult; // RowResult of the first row of the band which couldn't be read
+    int errorRow;
+    int errorValue;
+    MazeValidity validity;
+    int invalidRow;
+    int invalidCol;
+} TestChunk;
+
+// Shared by all tasks of test_parallel
+typedef struct {
+    const char *end; // End of the whole file, the last row of a band may continue past the end of its chunk
+    int rows;
+    int cols;
+    TestChunk *chunks;
+    int chunkCount;
+} TestContext;
+
+// First pass of test_parallel, counts the numbers inside a chunk
+void test_count_task(void *context, int chunkIndex, int workerIndex)
+{
+    (void)workerIndex;
+    TestChunk *chunk = &((TestContext *)context)->chunks[chunkIndex];
+    const char *pos = chunk->start;
+    long long numbers = count_numbers_blocks(&pos, chunk->end);
+    int count = numbers == -1 ? -1 : 0;
+    for(; pos < chunk->end && count != -1; pos++){
+        count = count_numbers_byte(pos);
+        numbers += count;
+    }
+    chunk->numbers = count == -1 ? -1 : numbers;
+}
+
+//
+// Second pass of test_parallel, validates the band of a chunk
+// The first row of the next band is validated too, so every seam between two bands is checked for UP/DOWN borders once
+//
+void test_band_task(void *context, int chunkIndex, int workerIndex)
+{
+    (void)workerIndex;
+    TestContext *test = context;
+    TestChunk *chunk = &test->chunks[chunkIndex];
+    chunk->failed = false;
+    chunk->rowResult = ROW_READ;
+    chunk->validity = MAZE_VALID;
+
+    // Rows counted from 0, a row belongs to the chunk holding its first cell
+    long long firstRow = (chunk->numbersBefore + test->cols - 1) / test->cols;
+    long long lastRow = test->rows - 1;
+    long long ownRows = test->rows - firstRow; // Rows without the seam, counted by --stats
+    if(chunkIndex + 1 < test->chunkCount){
+        long long nextFirstRow = (test->chunks[chunkIndex+1].numbersBefore + test->cols - 1) / test->cols;
+        if(nextFirstRow == firstRow){
+            return;
+        }
+        lastRow = nextFirstRow < lastRow ? nextFirstRow : lastRow;
+        ownRows = nextFirstRow - firstRow;
+    }
+    if(firstRow > lastRow){
+        return;
+    }
+
+    // End of a row which started in an earlier chunk
+    const char *cursor = chunk->start;
+    int value;
+    for(long long skipped = chunk->numbersBefore; skipped < firstRow * test->cols; skipped++){
+        if(scan_int(&cursor, test->end, &value) == -1){
+            chunk->rowResult = ROW_MISSING_CELL;
+            chunk->errorRow = (int)firstRow;
+            return;
+        }
+    }
+
+    Validator validator;
+    unsigned char *buffer = calloc(row_buffer_size(test->cols), sizeof(unsigned char));
+    if(buffer == NULL || validator_ctor(&validator, test->cols) == -1){
+        free(buffer);
+        chunk->failed = true;
+        return;
+    }
+    validator.row = (int)firstRow + 1;
+
+    long long row = firstRow;
+    for(; row <= lastRow; row++){
+        int result = scan_row(&cursor, test->end, test->cols, buffer + 1, &value);
+        if(result != ROW_READ){
+            chunk->rowResult = result;
+            chunk->errorRow = (int)row + 1;
+            chunk->errorValue = value;
+            break;
+        }
+        validator_push_row(&validator, buffer + 1);
+    }
+    STATS_ADD(cellsValidated, (row < firstRow + ownRows ? row - firstRow : ownRows) * test->cols);
+
+    chunk->validity = validator.validity;
+    chunk->invalidRow = validator.invalidRow;
+    chunk->invalidCol = validator.invalidCol;
+    validator_dtor(&validator);
+    free(buffer);
+}
+
+//
+// Validates the cells of a maze between start and end on threadCount threads, reports the same errors as scan_cells
+// First pass counts the numbers inside every chunk of the file, so that the second one knows where the bands start
+// Returns 0 for a valid maze, -1 for an invalid one and TEST_SERIAL when the file has to be validated by scan_cells,
+// which is when it's too small or holds anything else than digits and whitespace
+//
+int test_parallel(const char *start, const char *end, int rows, int cols)
+{
+    long long chunkCount = (end - start) / TEST_CHUNK_MIN_BYTES;
+    if(chunkCount > (long long)threadCount * TEST_CHUNKS_PER_THREAD){
+        chunkCount = (long long)threadCount * TEST_CHUNKS_PER_THREAD;
+    }
+    if(chunkCount < 2){
+        return TEST_SERIAL;
+    }
+
+    TestContext test = {.end = end, .rows = rows, .cols = cols, .chunkCount = (int)chunkCount};
+    test.chunks = malloc(sizeof(TestChunk) * test.chunkCount);
+    if(test.chunks == NULL){
+        return TEST_SERIAL;
+    }
+    const char *chunkStart = start;
+    for(int chunkIndex = 0; chunkIndex < test.chunkCount; chunkIndex++){
+        const char *chunkEnd = start + (end - start) * (chunkIndex + 1) / test.chunkCount;
+        if(chunkEnd < chunkStart){
+            chunkEnd = chunkStart;
+        }
+        while(chunkEnd < end && *chunkEnd != ' ' && (*chunkEnd < '\t' || *chunkEnd > '\r')){
+            chunkEnd++;
+        }
+        test.chunks[chunkIndex].start = chunkStart;
+        test.chunks[chunkIndex].end = chunkEnd;
+        chunkStart = chunkEnd;
+    }
+
+    int workerCount = threadCount < test.chunkCount ? threadCount : test.chunkCount;
+    int result = worker_pool_run(workerCount, test.chunkCount, test_count_task, &test) == -1 ? TEST_SERIAL : 0;
+    long long numbersBefore = 0;
+    for(int chunkIndex = 0; chunkIndex < test.chunkCount && result == 0; chunkIndex++){
+        if(test.chunks[chunkIndex].numbers == -1){
+            result = TEST_SERIAL;
+        }
+        test.chunks[chunkIndex].numbersBefore = numbersBefore;
+        numbersBefore += test.chunks[chunkIndex].numbers;
+    }
+    if(result == 0 && worker_pool_run(workerCount, test.chunkCount, test_band_task, &test) == -1){
+        result = TEST_SERIAL;
+    }
+    if(result == 0){
+        STATS_ADD(bytesParsed, end - start);
+    }
+
+    // Bands are in the order of the file, reading errors win over borders like in scan_cells
+    for(int chunkIndex = 0; chunkIndex < test.chunkCount && result == 0; chunkIndex++){
+        if(test.chunks[chunkIndex].failed){
+            result = TEST_SERIAL;
+        }
+    }
+    for(int chunkIndex = 0; chunkIndex < test.chunkCount && result == 0; chunkIndex++){
+        TestChunk *chunk = &test.chunks[chunkIndex];
+        if(chunk->rowResult != ROW_READ){
+            print_row_error(chunk->rowResult, chunk->errorRow, chunk->errorValue);
+            result = -1;
+        }
+    }
+    for(int chunkIndex = 0; chunkIndex < test.chunkCount && result == 0; chunkIndex++){
+        TestChunk *chunk = &test.chunks[chunkIndex];
+        if(chunk->validity != MAZE_VALID){
+            print_wrong_borders(chunk->invalidRow, chunk->invalidCol);
+            result = -1;
+        }
+    }
+
+    free(test.chunks);
+    return result;
+}
+
+//
+// Used for --test on a compiled maze, borders were validated by --compile so only the checksum of the cells is verified
+// Closes view, returns -1 if the maze is invalid or damaged
+//
+int test_tmaze(FileView *view)
+{
+    const TmazeHeader *header = tmaze_header(view);
+    const TmazeSection *cells = header != NULL ? tmaze_section(view, TMAZE_SECTION_CELLS) : NULL;
+    int result = -1;
+    if(header == NULL){
+        // Message is printed by tmaze_header
+    } else if(cells == NULL || cells->size != (uint64_t)header->rows * header->cols
+              || tmaze_checksum((const unsigned char *)view->data + cells->offset, cells->size) != header->checksum){
+        error_print("Error compiled maze is damaged\n");
+    } else if(header->rows == header->cols){
+        // Same rule as for text mazes
+        error_print("Error wrong matrix dimensions\n");
+    } else if(!(header->flags & TMAZE_FLAG_VALID)){
+        print_wrong_borders((int)header->invalidRow, (int)header->invalidCol);
+    } else {
+        result = 0;
+    }
+    file_view_close(view);
+    return result;
+}
+
+//
+// Checks if the contents and format of fileName is Valid or Invalid for defining a matrix, used by test
+// Cells are validated while streaming through the file, only a single row is kept in memory
+// With --threads large files are split into bands of rows validated in parallel (see test_parallel)
+//
+int test_file(const char *fileName)
+{
+    FileView view;
+    if(file_view_open(&view, fileName) == -1){
+        return -1;
+    }
+    if(tmaze_is(&view)){
+        return test_tmaze(&view);
+    }
+
+    const char *cursor = view.data;
+    int rows = 0, cols = 0;
+
+    if(scan_header(&cursor, view.end, &rows, &cols) == -1){
+        file_view_close(&view);
+        return -1;
+    }
+
+    // Matrix is Rectangular
+    // TODO not sure if this is needed
+    if(rows == cols){
+        fprintf(stderr, "Error wrong matrix dimensions\n");
+        file_view_close(&view);
+        return -1;
+    }
+
+    // Planes are validated by map_validate_planes, so the maze is loaded as a whole
+    if(mapStorage == MAP_STORAGE_PLANES){
+        file_view_close(&view);
+        Map *map;
+        if(map_ctor(&map, fileName) == -1){
+            return -1;
+        }
+        int result = map->validity == MAZE_VALID ? 0 : -1;
+        map_dtor(&map);
+        return result;
+    }
+
+    int result = threadCount > 1 ? test_parallel(cursor, view.end, rows, cols) : TEST_SERIAL;
+    if(result != TEST_SERIAL){
+        file_view_close(&view);
+        return result;
+    }
+
+    Validator validator;
+    if(validator_ctor(&validator, cols) == -1){
+        file_view_close(&view);
+        return -1;
+    }
+
+    result = scan_cells(&cursor, view.end, rows, cols, &validator, NULL);
+    if(validator.validity != MAZE_VALID){
+        result = -1;
+    }
+
+    validator_dtor(&validator);
+    file_view_close(&view);
+    return result;
+}
+
+// Used for --test, returns 0 if the maze inside fileName is valid and -1 otherwise
+int test(const char *fileName)
+{
+    uint64_t started = STATS_NOW();
+    int result = test_file(fileName);
+    STATS_ADD(validateNs, STATS_NOW() - started);
+    return result;
+}
+
+// Suffix of tar archives whose members --test-many validates one by one
+#define TAR_SUFFIX ".tar"
+// Size of a tar header, member data is padded to whole blocks
+#define TAR_BLOCK 512
+
+// Files written next to a maze, --test-many leaves them out of directories
+const char *sidecarSuffixes[] = {".components", ".distances", ".corridors"};
+
+// File or archive member validated by --test-many
+typedef struct {
+    char *name; // Printed at the start of its line
+    const char *data; // Contents of an archive member, NULL for a file read by the worker
+    size_t size;
+    bool isDone; // Result is known without validating, like for a damaged archive
+    bool isValid;
+    char reason[ERROR_REASON_SIZE];
+} TestItem;
+
+// Everything --test-many validates in the order it's printed, archives stay mapped until their members are validated
+typedef struct {
+    TestItem *items;
+    int itemCount;
+    int itemCapacity;
+    FileView *archives;
+    int archiveCount;
+    int archiveCapacity;
+} TestList;
+
+// Buffers of a --test-many worker, reused for every file it validates instead of allocating them per file
+typedef struct {
+    char *text; // Contents of the last file read by the worker
+    size_t textCapacity;
+    unsigned char *row; // Row buffer of scan_rows for mazes with up to cols columns
+    Validator validator;
+    int cols; // 0 until the worker validates its first maze
+} TestScratch;
+
+// Shared by the tasks of --test-many
+typedef struct {
+    TestItem *items;
+    TestScratch *scratches; // One for every worker
+} TestManyContext;
+
+// Destructor for TestList structure
+void test_list_dtor(TestList *list)
+{
+    for(int index = 0; index < list->itemCount; index++){
+        free(list->items[index].name);
+    }
+    for(int index = 0; index < list->archiveCount; index++){
+        file_view_close(&list->archives[index]);
+    }
+    free(list->items);
+    free(list->archives);
+}
+
+// Appends an item named name to list and takes over name, returns NULL on failure
+TestItem *test_list_add(TestList *list, char *name, const char *data, size_t size)
+{
+    if(name == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return NULL;
+    }
+    if(list->itemCount == list->itemCapacity){
+        int capacity = list->itemCapacity == 0 ? 64 : list->itemCapacity * 2;
+        TestItem *grown = realloc(list->items, sizeof(TestItem) * (size_t)capacity);
+        if(grown == NULL){
+            fprintf(stderr, "Malloc failed\n");
+            free(name);
+            return NULL;
+        }
+        list->items = grown;
+        list->itemCapacity = capacity;
+    }
+    TestItem *item = &list->items[list->itemCount++];
+    item->name = name;
+    item->data = data;
+    item->size = size;
+    item->isDone = false;
+    item->isValid = false;
+    item->reason[0] = '\0';
+    return item;
+}
+
+// Appends an item that is invalid for the reason kept in capture, returns -1 on failure
+int test_list_add_failed(TestList *list, const char *name, const ErrorCapture *capture)
+{
+    TestItem *item = test_list_add(list, strdup(name), NULL, 0);
+    if(item == NULL){
+        return -1;
+    }
+    item->isDone = true;
+    memcpy(item->reason, capture->text, sizeof(item->reason));
+    return 0;
+}
+
+// Reads an octal number field of a tar header, returns -1 if it isn't one
+long long tar_octal(const char *field, int length)
+{
+    int index = 0;
+    while(index < length && field[index] == ' '){
+        index++;
+    }
+    int start = index;
+    long long value = 0;
+    for(; index < length && field[index] >= '0' && field[index] <= '7'; index++){
+        if(value > LLONG_MAX >> 3){
+            return -1;
+        }
+        value = value * 8 + (field[index] - '0');
+    }
+    if(index == start || (index < length && field[index] != '\0' && field[index] != ' ')){
+        return -1;
+    }
+    return value;
+}
+
+// Sum of the bytes of a tar header with its checksum field taken as spaces
+long long tar_checksum(const char *header)
+{
+    long long sum = 0;
+    for(int index = 0; index < TAR_BLOCK; index++){
+        sum += index >= 148 && index < 156 ? ' ' : (unsigned char)header[index];
+    }
+    return sum;
+}
+
+//
+// Appends the regular files inside the tar archive fileName as "fileName/member", their data is used straight
+// from the mapped archive, long names of GNU tar and the prefix of ustar are followed, other entries are skipped
+// A damaged archive or one that can't be read also gets a line of its own, returns -1 on failure
+//
+int test_list_add_archive(TestList *list, const char *fileName)
+{
+    if(list->archiveCount == list->archiveCapacity){
+        int capacity = list->archiveCapacity == 0 ? 4 : list->archiveCapacity * 2;
+        FileView *grown = realloc(list->archives, sizeof(FileView) * (size_t)capacity);
+        if(grown == NULL){
+            fprintf(stderr, "Malloc failed\n");
+            return -1;
+        }
+        list->archives = grown;
+        list->archiveCapacity = capacity;
+    }
+
+    ErrorCapture capture = {.isSet = false};
+    errorCapture = &capture;
+    FileView *view = &list->archives[list->archiveCount];
+    if(file_view_open(view, fileName) == -1){
+        errorCapture = NULL;
+        return test_list_add_failed(list, fileName, &capture);
+    }
+    list->archiveCount++;
+
+    const char *longName = NULL;
+    size_t longNameLength = 0;
+    size_t offset = 0;
+    while(offset + TAR_BLOCK <= view->size && view->data[offset] != '\0'){
+        const char *header = view->data + offset;
+        long long size = tar_octal(header + 124, 12);
+        if(size < 0 || tar_octal(header + 148, 8) != tar_checksum(header)
+           || (unsigned long long)size > view->size - offset - TAR_BLOCK){
+            error_print("Error archive is damaged\n");
+            break;
+        }
+        const char *data = header + TAR_BLOCK;
+        char type = header[156];
+
+        if(type == 'L'){
+            longName = data;
+            longNameLength = strnlen(data, (size_t)size);
+        } else {
+            if(type == '0' || type == '\0'){
+                // ustar keeps the directories of long names in a prefix field
+                const char *prefix = memcmp(header + 257, "ustar", 5) == 0 ? header + 345 : "";
+                int prefixLength = longName != NULL ? 0 : (int)strnlen(prefix, 155);
+                const char *name = longName != NULL ? longName : header;
+                int nameLength = longName != NULL ? (int)longNameLength : (int)strnlen(header, 100);
+
+                size_t memberSize = strlen(fileName) + prefixLength + nameLength + 3;
+                char *member = malloc(memberSize);
+                if(member != NULL){
+                    snprintf(member, memberSize, "%s/%.*s%s%.*s", fileName, prefixLength, prefix,
+                             prefixLength > 0 ? "/" : "", nameLength, name);
+                }
+                if(test_list_add(list, member, data, (size_t)size) == NULL){
+                    errorCapture = NULL;
+                    return -1;
+                }
+            }
+            longName = NULL;
+        }
+        offset += TAR_BLOCK + ((size_t)size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+    }
+    // Archive cut off inside a header or the padding of its last member
+    if(!capture.isSet && offset != view->size && (offset > view->size || view->size - offset < TAR_BLOCK)){
+        error_print("Error archive is damaged\n");
+    }
+    errorCapture = NULL;
+    return capture.isSet ? test_list_add_failed(list, fileName, &capture) : 0;
+}
+
+// Appends the file fileName, or the members of an archive, returns -1 on failure
+int test_list_add_file(TestList *list, const char *fileName)
+{
+    size_t length = strlen(fileName);
+    if(length > strlen(TAR_SUFFIX) && strcmp(fileName + length - strlen(TAR_SUFFIX), TAR_SUFFIX) == 0){
+        return test_list_add_archive(list, fileName);
+    }
+    return test_list_add(list, strdup(fileName), NULL, 0) == NULL ? -1 : 0;
+}
+
+// Returns true if a directory entry named name is left out by --test-many
+bool test_skips_entry(const char *name)
+{
+    if(name[0] == '.'){
+        return true;
+    }
+    size_t length = strlen(name);
+    for(size_t index = 0; index < sizeof(sidecarSuffixes) / sizeof(sidecarSuffixes[0]); index++){
+        size_t suffixLength = strlen(sidecarSuffixes[index]);
+        if(length > suffixLength && strcmp(name + length - suffixLength, sidecarSuffixes[index]) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Orders file names for qsort
+int file_name_compare(const void *first, const void *second)
+{
+    return strcmp(*(char *const *)first, *(char *const *)second);
+}
+
+//
+// Appends the regular files of directory in the order of their names, subdirectories, hidden files and sidecars
+// are left out, returns -1 on failure
+//
+int test_list_add_directory(TestList *list, const char *directory)
+{
+    DIR *stream = opendir(directory);
+    if(stream == NULL){
+        ErrorCapture capture = {.isSet = true};
+        snprintf(capture.text, sizeof(capture.text), "Error opening directory\n");
+        return test_list_add_failed(list, directory, &capture);
+    }
+
+    char **names = NULL;
+    int nameCount = 0, nameCapacity = 0;
+    int result = 0;
+    struct dirent *entry;
+    while(result == 0 && (entry = readdir(stream)) != NULL){
+        if(test_skips_entry(entry->d_name)){
+            continue;
+        }
+        size_t pathSize = strlen(directory) + strlen(entry->d_name) + 2;
+        char *path = malloc(pathSize);
+        if(nameCount == nameCapacity){
+            nameCapacity = nameCapacity == 0 ? 64 : nameCapacity * 2;
+            char **grown = realloc(names, sizeof(char *) * (size_t)nameCapacity);
+            if(grown != NULL){
+                names = grown;
+            } else {
+                nameCapacity = nameCount;
+            }
+        }
+        if(path == NULL || nameCount == nameCapacity){
+            fprintf(stderr, "Malloc failed\n");
+            free(path);
+            result = -1;
+            break;
+        }
+        snprintf(path, pathSize, "%s/%s", directory, entry->d_name);
+        struct stat fileInfo;
+        if(stat(path, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)){
+            names[nameCount++] = path;
+        } else {
+            free(path);
+        }
+    }
+    closedir(stream);
+
+    qsort(names, (size_t)nameCount, sizeof(char *), file_name_compare);
+    for(int index = 0; index < nameCount; index++){
+        if(result == 0){
+            result = test_list_add_file(list, names[index]);
+        }
+        free(names[index]);
+    }
+    free(names);
+    return result;
+}
+
+// Destructor for TestScratch structure
+void test_scratch_dtor(TestScratch *scratch)
+{
+    free(scratch->text);
+    free(scratch->row);
+    validator_dtor(&scratch->validator);
+}
+
+// Reads fileName into the text buffer of scratch, which only grows for a file larger than any before it
+int test_scratch_read(TestScratch *scratch, const char *fileName, size_t *size)
+{
+    int fd = open(fileName, O_RDONLY);
+    if(fd == -1){
+        error_print("Error opening file\n");
+        return -1;
+    }
+    *size = 0;
+    ssize_t readBytes = 0;
+    do {
+        *size += (size_t)readBytes;
+        if(*size == scratch->textCapacity){
+            size_t capacity = scratch->textCapacity == 0 ? 65536 : scratch->textCapacity * 2;
+            char *grown = realloc(scratch->text, capacity);
+            if(grown == NULL){
+                error_print("Malloc failed\n");
+                close(fd);
+                return -1;
+            }
+            scratch->text = grown;
+            scratch->textCapacity = capacity;
+        }
+        readBytes = read(fd, scratch->text + *size, scratch->textCapacity - *size);
+    } while(readBytes > 0);
+    close(fd);
+
+    if(readBytes == -1){
+        error_print("Error reading file\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Makes the validator and row buffer of scratch fit a maze with cols columns and starts the validator over
+int test_scratch_fit(TestScratch *scratch, int cols)
+{
+    if(cols > scratch->cols){
+        validator_dtor(&scratch->validator);
+        free(scratch->row);
+        scratch->cols = 0;
+        scratch->row = malloc(row_buffer_size(cols));
+        if(scratch->row == NULL || validator_ctor(&scratch->validator, cols) == -1){
+            error_print("Malloc failed on validator\n");
+            return -1;
+        }
+        scratch->cols = cols;
+    }
+    // Padding behind the cells has to be zero again after a wider maze
+    memset(scratch->row, 0, row_buffer_size(cols));
+    scratch->validator.cols = cols;
+    scratch->validator.row = 1;
+    scratch->validator.hasAbove = false;
+    scratch->validator.validity = MAZE_VALID;
+    return 0;
+}
+
+// Validates the maze held in data on a single thread like test_file, returns 0 if it's valid and -1 otherwise
+int test_text(TestScratch *scratch, const char *data, size_t size)
+{
+    FileView view = {.data = data, .end = data + size, .memory = NULL, .size = size, .isMapped = false};
+    if(tmaze_is(&view)){
+        return test_tmaze(&view);
+    }
+
+    const char *cursor = data;
+    int rows = 0, cols = 0;
+    if(scan_header(&cursor, view.end, &rows, &cols) == -1){
+        return -1;
+    }
+    if(rows == cols){
+        error_print("Error wrong matrix dimensions\n");
+        return -1;
+    }
+    if(test_scratch_fit(scratch, cols) == -1){
+        return -1;
+    }
+    int result = scan_rows(&cursor, view.end, rows, cols, scratch->row + 1, &scratch->validator, NULL);
+    return result == 0 && scratch->validator.validity == MAZE_VALID ? 0 : -1;
+}
+
+// Task of --test-many validating a single item with the buffers of its worker
+void test_many_task(void *context, int itemIndex, int workerIndex)
+{
+    TestManyContext *test = context;
+    TestItem *item = &test->items[itemIndex];
+    if(item->isDone){
+        return;
     }
+    TestScratch *scratch = &test->scratches[workerIndex];
 
-    bool isBorderInDirection = isborder(map, triangleToMove.pos.r, triangleToMove.pos.c, direction);
+    ErrorCapture capture = {.isSet = false};
+    errorCapture = &capture;
+    const char *data = item->data;
+    size_t size = item->size;
+    int result = 0;
+    if(data == NULL){
+        result = test_scratch_read(scratch, item->name, &size);
+        data = scratch->text;
+    }
+    if(result == 0){
+        result = test_text(scratch, data, size);
+    }
+    errorCapture = NULL;
 
-    if(isBorderInDirection){
-        fprintf(stderr, "Error cannot move in that direction border is in a way\n");
-        return -1;
+    item->isValid = result == 0;
+    memcpy(item->reason, capture.text, sizeof(item->reason));
+    if(!capture.isSet){
+        item->reason[0] = '\0';
     }
-    
-    // Illegal states
-    if(triangleToMove.pos.c == 1 && triangleToMove.pos.r == 1 && (direction == L || direction == U)){
-        fprintf(stderr, "Error cannot move in that direction\n");
-        return 1;
+}
+
+//
+// Used for --test-many, validates files, every file of directories and the members of tar archives in paths
+// Files are spread over threadCount workers that keep their buffers, so small files cost no allocation
+// Prints "path: Valid" or "path: Invalid: reason" for every file in the order they were given, returns -1 on failure
+//
+int test_many(char **paths, int pathCount)
+{
+    uint64_t started = STATS_NOW();
+    TestList list = {0};
+    int result = 0;
+    for(int index = 0; index < pathCount && result == 0; index++){
+        struct stat fileInfo;
+        if(stat(paths[index], &fileInfo) == 0 && S_ISDIR(fileInfo.st_mode)){
+            result = test_list_add_directory(&list, paths[index]);
+        } else {
+            result = test_list_add_file(&list, paths[index]);
+        }
     }
-    if(triangleToMove.pos.c == map->cols && triangleToMove.pos.r == map->rows && (direction == R || direction == D)){
-        fprintf(stderr, "Error cannot move in that direction\n");
-        return 1;
+
+    int workerCount = threadCount < list.itemCount ? threadCount : list.itemCount;
+    TestScratch *scratches = calloc(workerCount > 0 ? (size_t)workerCount : 1, sizeof(TestScratch));
+    if(scratches == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        result = -1;
+    }
+    if(result == 0 && list.itemCount > 0){
+        TestManyContext context = {list.items, scratches};
+        result = worker_pool_run(workerCount, list.itemCount, test_many_task, &context);
     }
 
-    // resultingTriangle would've moved outside the maze resulting in the completion of the maze
-    if(triangleToMove.pos.c == map->cols && direction == R){
-        return 1;
+    for(int index = 0; index < list.itemCount && result == 0; index++){
+        TestItem *item = &list.items[index];
+        if(item->isValid){
+            printf("%s: Valid\n", item->name);
+            continue;
+        }
+        // Reason is the first error message without its "Error " and newline
+        char *reason = item->reason;
+        if(strncmp(reason, "Error ", 6) == 0){
+            reason += 6;
+        }
+        reason[strcspn(reason, "\n")] = '\0';
+        printf("%s: Invalid%s%s\n", item->name, reason[0] != '\0' ? ": " : "", reason);
     }
-    if(triangleToMove.pos.c == 1 && direction == L){
-        return 1;
+
+    for(int worker = 0; scratches != NULL && worker < workerCount; worker++){
+        test_scratch_dtor(&scratches[worker]);
     }
-    if(triangleToMove.pos.r == map->rows && direction == D){
-        return 1;
+    free(scratches);
+    test_list_dtor(&list);
+    STATS_ADD(validateNs, STATS_NOW() - started);
+    return result;
+}
+
+// Kinds of queries accepted by --batch
+typedef enum {
+    QUERY_RPATH,
+    QUERY_LPATH,
+    QUERY_SHORTEST,
+    QUERY_INVALID, // Line that couldn't be parsed
+} QueryMode;
+
+// Names of QueryMode values used in query lines
+const char *queryModeNames[] = {"rpath", "lpath", "shortest", "invalid"};
+
+// Single line of a --batch queries file
+typedef struct {
+    QueryMode mode;
+    int r;
+    int c;
+} Query;
+
+//
+// Parses "MODE R C" from the start of a line, whitespace around values is ignored
+// Returns query->mode == QUERY_INVALID if the line doesn't hold a valid query
+//
+void parse_query(const char *line, const char *lineEnd, Query *query)
+{
+    query->mode = QUERY_INVALID;
+    query->r = 0;
+    query->c = 0;
+
+    while(line < lineEnd && (*line == ' ' || *line == '\t')){
+        line++;
     }
-    if(triangleToMove.pos.r == 1 && direction == U){
-        return 1;
+    const char *nameEnd = line;
+    while(nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t'){
+        nameEnd++;
+    }
+
+    QueryMode mode = QUERY_INVALID;
+    for(int modeIndex = QUERY_RPATH; modeIndex < QUERY_INVALID; modeIndex++){
+        if(strlen(queryModeNames[modeIndex]) == (size_t)(nameEnd - line) && strncmp(line, queryModeNames[modeIndex], nameEnd - line) == 0){
+            mode = modeIndex;
+        }
     }
-    
-    // Matches array indexes to Direction enum by -1 to account for it starting at L=1
-    initialize_triangle(map, resultingTriangle, triangleToMove.pos.r + directionVector[direction-1].r,triangleToMove.pos.c + directionVector[direction-1].c);
-    return 0;
 
+    const char *cursor = nameEnd;
+    if(mode == QUERY_INVALID || scan_int(&cursor, lineEnd, &query->r) == -1 || scan_int(&cursor, lineEnd, &query->c) == -1){
+        return;
+    }
+    while(cursor < lineEnd && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')){
+        cursor++;
+    }
+    if(cursor == lineEnd){
+        query->mode = mode;
+    }
 }
 
-// Checks if the contents and format of a file is Valid or Invalid for defining a matrix
-int test(const char *fileName)
+//
+// Reads every line of fileName into *items of itemSize bytes with parse, empty lines and lines starting with # are skipped
+// parse gets the line without its leading whitespace, returns the number of items or -1 on failure
+//
+int read_lines(const char *fileName, void **items, size_t itemSize, void (*parse)(const char *line, const char *lineEnd, void *item))
 {
-    Map *map;
+    FileView view;
+    if(file_view_open(&view, fileName) == -1){
+        return -1;
+    }
 
-    int rows, cols;
-    FILE *file = fopen(fileName, "r");
-    if(file == NULL){
-        fprintf(stderr, "Error opening file\n");
-        fclose(file);
+    int itemCount = 0, capacity = 0;
+    *items = NULL;
+    for(const char *line = view.data; line < view.end;){
+        const char *lineEnd = memchr(line, '\n', view.end - line);
+        if(lineEnd == NULL){
+            lineEnd = view.end;
+        }
+
+        const char *firstChar = line;
+        while(firstChar < lineEnd && (*firstChar == ' ' || *firstChar == '\t' || *firstChar == '\r')){
+            firstChar++;
+        }
+        if(firstChar < lineEnd && *firstChar != '#'){
+            if(itemCount == capacity){
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                void *grown = realloc(*items, itemSize * capacity);
+                if(grown == NULL){
+                    fprintf(stderr, "Malloc failed on lines of %s\n", fileName);
+                    free(*items);
+                    file_view_close(&view);
+                    return -1;
+                }
+                *items = grown;
+            }
+            parse(firstChar, lineEnd, (char *)*items + itemSize * itemCount++);
+        }
+        line = lineEnd + 1;
+    }
+
+    file_view_close(&view);
+    return itemCount;
+}
+
+// Calls parse_query for read_lines
+void parse_query_line(const char *line, const char *lineEnd, void *query)
+{
+    parse_query(line, lineEnd, query);
+}
+
+// Reads all queries from fileName into *queries, returns the number of queries or -1 on failure
+int read_queries(const char *fileName, Query **queries)
+{
+    return read_lines(fileName, (void **)queries, sizeof(Query), parse_query_line);
+}
+
+// Names of SearchResult values printed after every --batch query, indexed by result + 1
+const char *searchResultNames[] = {"error", "found", "looped", "step-limit"};
+
+// Solves a single query, graph or field is only needed for QUERY_SHORTEST, returns a SearchResult
+int run_query(Map *map, Graph *graph, DistanceField *field, SearchWorkspace *workspace, Query *query, PathSink *sink)
+{
+    switch(query->mode){
+        case QUERY_RPATH:
+            return search_maze(map, NULL, workspace, query->r, query->c, R, sink);
+        case QUERY_LPATH:
+            return search_maze(map, NULL, workspace, query->r, query->c, L, sink);
+        case QUERY_SHORTEST:
+            if(field != NULL){
+                return distance_field_path(field, query->r, query->c, sink);
+            }
+            return shortest_path(map, graph, workspace, query->r, query->c, sink);
+        default:
+            fprintf(stderr, "Error query couldn't be parsed\n");
+            return SEARCH_ERROR;
+    }
+}
+
+// Writes a "> MODE R C" line starting the result of query into sink
+void path_sink_query_header(PathSink *sink, Query *query)
+{
+    char header[64];
+    int length;
+    if(query->mode == QUERY_INVALID){
+        length = snprintf(header, sizeof(header), "> %s\n", queryModeNames[query->mode]);
+    } else {
+        length = snprintf(header, sizeof(header), "> %s %d %d\n", queryModeNames[query->mode], query->r, query->c);
+    }
+    path_sink_write(sink, header, length);
+}
+
+// Writes a "< RESULT" line ending the result of a query into sink
+void path_sink_query_footer(PathSink *sink, int result)
+{
+    char footer[32];
+    int length = snprintf(footer, sizeof(footer), "< %s\n", searchResultNames[result + 1]);
+    path_sink_write(sink, footer, length);
+}
+
+// Shared state of --batch split between threads
+typedef struct {
+    Map **maps; // One for every worker, see map_worker_copies
+    Graph *graph;
+    DistanceField *field;
+    Query *queries;
+    SearchWorkspace *workspaces; // One for every worker
+    PathSink *results; // Output of every query kept in memory until the main thread writes it out in order
+    bool *finished;
+    pthread_mutex_t lock;
+    pthread_cond_t finishedCond;
+} BatchContext;
+
+// Solves a single query of a BatchContext into its own memory PathSink
+void batch_task(void *context, int queryIndex, int workerIndex)
+{
+    BatchContext *batch = context;
+    PathSink *result = &batch->results[queryIndex];
+
+    if(path_sink_ctor(result, PATH_SINK_MEMORY, pathFormat) == 0){
+        path_sink_query_header(result, &batch->queries[queryIndex]);
+        path_sink_query_footer(result, run_query(batch->maps[workerIndex], batch->graph, batch->field, &batch->workspaces[workerIndex], &batch->queries[queryIndex], result));
+    } else {
+        result->buffer = NULL;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    batch->finished[queryIndex] = true;
+    pthread_cond_broadcast(&batch->finishedCond);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+//
+// Solves queries on threadCount threads, the main thread only writes finished results into sink in input order
+// so that the output is the same as if they were solved one after another
+//
+int run_batch_parallel(Map *map, Graph *graph, DistanceField *field, Query *queries, int queryCount, PathSink *sink)
+{
+    int workerCount = threadCount < queryCount ? threadCount : queryCount;
+    BatchContext batch = {.graph = graph, .field = field, .queries = queries};
+    batch.results = malloc(sizeof(PathSink) * queryCount);
+    batch.finished = calloc(queryCount, sizeof(bool));
+    batch.workspaces = malloc(sizeof(SearchWorkspace) * workerCount);
+    batch.maps = malloc(sizeof(Map *) * workerCount);
+    bool allocated = batch.results != NULL && batch.finished != NULL && batch.workspaces != NULL && batch.maps != NULL;
+    if(!allocated){
+        fprintf(stderr, "Malloc failed on batch results\n");
+    }
+    if(!allocated || map_worker_copies(map, workerCount, batch.maps) == -1){
+        free(batch.results);
+        free(batch.finished);
+        free(batch.workspaces);
+        free(batch.maps);
+        return -1;
+    }
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        workspace_ctor(&batch.workspaces[workerIndex], (int64_t)map->rows * map->cols);
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.finishedCond, NULL);
+
+    WorkerPool pool;
+    int result = worker_pool_start(&pool, workerCount, queryCount, batch_task, &batch);
+
+    for(int queryIndex = 0; queryIndex < queryCount && result == 0; queryIndex++){
+        pthread_mutex_lock(&batch.lock);
+        while(!batch.finished[queryIndex]){
+            pthread_cond_wait(&batch.finishedCond, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        PathSink *queryOutput = &batch.results[queryIndex];
+        if(queryOutput->buffer == NULL){
+            path_sink_query_header(sink, &queries[queryIndex]);
+            path_sink_query_footer(sink, SEARCH_ERROR);
+            continue;
+        }
+        path_sink_write(sink, queryOutput->buffer, queryOutput->used);
+        path_sink_dtor(queryOutput);
+    }
+
+    if(result == 0){
+        worker_pool_join(&pool);
+    }
+    for(int workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        workspace_dtor(&batch.workspaces[workerIndex]);
+    }
+    map_worker_copies_dtor(map, workerCount, batch.maps);
+    pthread_cond_destroy(&batch.finishedCond);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.results);
+    free(batch.finished);
+    free(batch.workspaces);
+    free(batch.maps);
+    return result;
+}
+
+//
+// Used for --batch, answers every query from queriesFileName using a single loaded map
+// Result of each query is written as "> MODE R C", the path and "< RESULT" where RESULT is one of searchResultNames
+// Shortest paths follow the distances sidecar of mazeFileName when it's up to date
+//
+int run_batch(Map *map, const char *queriesFileName, const char *mazeFileName, PathSink *sink)
+{
+    Query *queries;
+    int queryCount = read_queries(queriesFileName, &queries);
+    if(queryCount == -1){
         return -1;
     }
 
-    if(fscanf(file, "%d %d", &rows, &cols) != 2){
-        fprintf(stderr, "Error reading rows and cols from file\n");
-        fclose(file);
+    // Graph or field is shared by all --shortest queries and prepared only if there is one
+    bool hasShortest = false;
+    for(int queryIndex = 0; queryIndex < queryCount; queryIndex++){
+        hasShortest = hasShortest || queries[queryIndex].mode == QUERY_SHORTEST;
+    }
+    Graph *graph = NULL;
+    DistanceField field;
+    bool hasField = hasShortest && distance_field_load(&field, mazeFileName) == 0;
+    if(hasShortest && !hasField && graph_ctor(&graph, map) == -1){
+        free(queries);
         return -1;
     }
-    
-    // Matrix is Rectangular
-    // TODO not sure if this is needed
-    if(rows == cols || rows < 1 || cols < 1){
-        fprintf(stderr, "Error wrong matrix dimensions");
-        fclose(file);
+
+    int result = 0;
+    if(threadCount > 1 && queryCount > 1){
+        result = run_batch_parallel(map, graph, hasField ? &field : NULL, queries, queryCount, sink);
+    } else {
+        SearchWorkspace workspace;
+        workspace_ctor(&workspace, (int64_t)map->rows * map->cols);
+        for(int queryIndex = 0; queryIndex < queryCount; queryIndex++){
+            path_sink_query_header(sink, &queries[queryIndex]);
+            path_sink_query_footer(sink, run_query(map, graph, hasField ? &field : NULL, &workspace, &queries[queryIndex], sink));
+        }
+        workspace_dtor(&workspace);
+    }
+
+    if(hasField){
+        distance_field_dtor(&field);
+    }
+    graph_dtor(&graph);
+    free(queries);
+    return result;
+}
+
+//
+// Parses "set R C SIDE" or "clear R C SIDE" from the start of a line for read_lines, SIDE is one of sideNames
+// Leaves side at NUM_OF_SIDES if the line doesn't hold a valid patch
+//
+void parse_patch(const char *line, const char *lineEnd, void *item)
+{
+    BorderPatch *patch = item;
+    patch->side = NUM_OF_SIDES;
+    const char *cursor = line;
+    while(cursor < lineEnd && *cursor != ' ' && *cursor != '\t'){
+        cursor++;
+    }
+    if((cursor - line != 3 || strncmp(line, "set", 3) != 0) && (cursor - line != 5 || strncmp(line, "clear", 5) != 0)){
+        return;
+    }
+    patch->isBorder = *line == 's';
+    if(scan_int(&cursor, lineEnd, &patch->r) == -1 || scan_int(&cursor, lineEnd, &patch->c) == -1){
+        return;
+    }
+
+    while(cursor < lineEnd && (*cursor == ' ' || *cursor == '\t')){
+        cursor++;
+    }
+    const char *nameEnd = cursor;
+    while(nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r'){
+        nameEnd++;
+    }
+    Side side = NUM_OF_SIDES;
+    for(Side sideIndex = LEFT_SIDE; sideIndex < NUM_OF_SIDES; sideIndex++){
+        if(strlen(sideNames[sideIndex]) == (size_t)(nameEnd - cursor) && strncmp(cursor, sideNames[sideIndex], nameEnd - cursor) == 0){
+            side = sideIndex;
+        }
+    }
+    while(nameEnd < lineEnd && (*nameEnd == ' ' || *nameEnd == '\t' || *nameEnd == '\r')){
+        nameEnd++;
+    }
+    if(nameEnd == lineEnd){
+        patch->side = side;
+    }
+}
+
+//
+// Used for --apply-patch, applies every line of patchFileName to the text maze mazeFileName and saves it in place
+// Up to date components and distances sidecars are patched along with the maze and saved again, so they stay up to date
+// Nothing is written unless every patch is valid, returns -1 on failure
+//
+int apply_patches(const char *patchFileName, const char *mazeFileName)
+{
+    BorderPatch *patches;
+    int patchCount = read_lines(patchFileName, (void **)&patches, sizeof(BorderPatch), parse_patch);
+    if(patchCount == -1){
         return -1;
     }
+    for(int patchIndex = 0; patchIndex < patchCount; patchIndex++){
+        if(patches[patchIndex].side == NUM_OF_SIDES){
+            fprintf(stderr, "Error patch %d couldn't be parsed\n", patchIndex + 1);
+            free(patches);
+            return -1;
+        }
+    }
 
-    int matrix[rows][cols];
+    Map *map;
+    if(mapStorage == MAP_STORAGE_TILES){
+        fprintf(stderr, "Error --apply-patch can't use --storage tiles\n");
+        free(patches);
+        return -1;
+    }
+    if(map_ctor(&map, mazeFileName) == -1){
+        free(patches);
+        return -1;
+    }
+    int result = 0;
+    if(map->isTmaze){
+        fprintf(stderr, "Error --apply-patch needs a text maze\n");
+        result = -1;
+    } else if(map->validity != MAZE_VALID){
+        fprintf(stderr, "Error --apply-patch needs a valid maze\n");
+        result = -1;
+    }
+    for(int patchIndex = 0; patchIndex < patchCount && result == 0; patchIndex++){
+        BorderPatch *patch = &patches[patchIndex];
+        if(patch->r < 1 || patch->c < 1 || patch->r > map->rows || patch->c > map->cols){
+            fprintf(stderr, "Error patch %d is outside of the maze\n", patchIndex + 1);
+            result = -1;
+        }
+    }
+    if(result == -1){
+        map_dtor(&map);
+        free(patches);
+        return -1;
+    }
 
-    // Checks if a row contains a valid amount of elements and if the provided elements are in bounds
-    for(int row = 0; row < rows; row++){
-        int readCount = 0;
-        for(int col = 0; col < cols; col++){
-            if(fscanf(file, "%d", &matrix[row][col]) == 1){
-                readCount++;
-            } else{
-                fprintf(stderr, "Error reading row from file\n");
-                fclose(file);
-                return -1;
-            }
+    // Sidecars have to be loaded before the maze file changes, they wouldn't match it afterwards
+    Components components;
+    DistanceField field;
+    bool hasComponents = components_load(&components, mazeFileName) == 0;
+    bool hasField = distance_field_load(&field, mazeFileName) == 0;
+    if((hasComponents && components_thaw(&components) == -1) || (hasField && distance_field_thaw(&field) == -1)){
+        result = -1;
+    }
 
-            // Check if an element is in bounds of 3 bits
-            if(!(matrix[row][col] >= 0 && matrix[row][col] <= 7)){
-                fprintf(stderr, "Error row %d from file is out of bounds: [%d] != (0-7)\n", row, matrix[row][col]);
-                fclose(file);
-                return -1;
-            }
+    SearchWorkspace workspace;
+    workspace_ctor(&workspace, (int64_t)map->rows * map->cols);
+    IndexList changedCells = {NULL, 0, 0};
+    int changedCount = 0;
+    for(int patchIndex = 0; patchIndex < patchCount && result == 0; patchIndex++){
+        BorderPatch *patch = &patches[patchIndex];
+        int cellIndex = (patch->r-1) * map->cols + (patch->c-1);
+        int neighbour = map_neighbour(map, cellIndex, patch->side);
+        bool wasExit = map_is_exit(map, cellIndex);
+        int changed = map_patch_border(map, patch);
+        if(changed <= 0){
+            result = changed;
+            continue;
+        }
+        changedCount++;
+        if(index_list_push(&changedCells, cellIndex) == -1 || (neighbour >= 0 && index_list_push(&changedCells, neighbour) == -1)
+           || (hasComponents && components_patch(&components, map, &workspace, cellIndex, patch->side, wasExit) == -1)
+           || (hasField && distance_field_patch(&field, map, &workspace, cellIndex, patch->side, wasExit) == -1)){
+            result = -1;
         }
     }
+    workspace_dtor(&workspace);
+
+    // Sidecars are saved after the maze, so that they carry its new modification time
+    if(result == 0 && changedCount > 0){
+        result = map_write_cells(map, mazeFileName, &changedCells);
+    }
+    if(result == 0 && changedCount > 0 && hasComponents){
+        result = components_compact(&components) == 0 ? components_write(&components, mazeFileName) : -1;
+    }
+    if(result == 0 && changedCount > 0 && hasField){
+        result = distance_field_write(&field, mazeFileName);
+    }
+    if(result == 0){
+        printf("%d of %d patches changed the maze\n", changedCount, patchCount);
+    }
+
+    if(hasComponents){
+        components_dtor(&components);
+    }
+    if(hasField){
+        distance_field_dtor(&field);
+    }
+    free(changedCells.items);
+    map_dtor(&map);
+    free(patches);
+    return result;
+}
 
-    fclose(file);
+// Mazes kept loaded by --serve, the least recently used one is dropped first
+#define SERVE_MAZE_LIMIT 8
+// Longest request line --serve accepts, a client sending a longer one is disconnected
+#define SERVE_LINE_LIMIT 8192
+// Events taken by a single epoll_wait of --serve
+#define SERVE_EVENTS 64
 
-    // CHECK IF ADJACENED BORDERS ARE SET CORRECTLY
+// A maze kept loaded by --serve, it's loaded again once its file changes
+typedef struct {
+    char *fileName; // NULL for an unused slot
+    int64_t sourceSize; // Size and modification time of the file the maze was loaded from
+    int64_t sourceModified;
+    Map *map; // Only read by workers while graphLock is held, searches use workerMaps
+    Map **workerMaps; // One for every worker, see map_worker_copies
+    Graph *graph; // Built by the first shortest request unless field is up to date
+    pthread_mutex_t graphLock; // Held while graph is built
+    DistanceField field;
+    bool hasField;
+    SearchWorkspace *workspaces; // One for every worker, buffers are allocated by the first search of the worker
+    int workspaceCount;
+    uint64_t lastUsed; // Number of the last request which used the maze
+    int users; // Requests using the maze right now, a slot is only loaded again once there are none
+    bool isLoading; // Loaded by a worker outside of Server.lock, requests for the same file wait for it
+} ServedMaze;
 
-    if(map_ctor(&map, fileName) == -1){
+// A connection of --serve, clients are linked together so that they can be closed when the server stops
+typedef struct ServeClient {
+    int fd;
+    char *input; // Bytes received after the last answered line, at most SERVE_LINE_LIMIT
+    size_t inputUsed;
+    char *request; // Line inside input answered by a worker right now, NULL while the client isn't busy
+    size_t requestLength; // Bytes of input taken by the line including its newline
+    uint64_t requestNumber;
+    bool failed; // Answer couldn't be sent, the client is closed
+    bool isClosing; // Client won't send anything more, it's closed once all answers are sent
+    bool isWatched; // Registered in the epoll instance, busy clients aren't
+    struct ServeClient *previous;
+    struct ServeClient *next;
+    struct ServeClient *nextJob; // Next client in Server.jobs or Server.finished
+} ServeClient;
+
+//
+// State of --serve shared by the thread running the event loop and the workers answering requests
+// The event loop reads request lines and queues a client with a complete line as a job, a worker answers it
+// straight into the socket of the client and hands the client back through finished and wakeFd
+//
+typedef struct {
+    ServedMaze mazes[SERVE_MAZE_LIMIT];
+    int workerCount;
+    pthread_mutex_t lock; // Guards everything below and the slots of mazes
+    pthread_cond_t mazeChanged; // Signalled when a maze is loaded or a slot isn't used any more
+    pthread_cond_t jobQueued; // Signalled when a job is queued or the server stops
+    ServeClient *jobs; // Clients waiting for a worker, oldest first
+    ServeClient *lastJob;
+    ServeClient *finished; // Clients whose request was answered, taken back by the event loop
+    int wakeFd; // eventfd written by workers after adding to finished
+    bool isStopping;
+    pthread_t loopThread;
+} Server;
+
+// Set by SIGINT and SIGTERM, --serve stops after the current events
+volatile sig_atomic_t serveStopped = 0;
+
+// Signal handler of --serve
+void serve_stop(int signalNumber)
+{
+    (void)signalNumber;
+    serveStopped = 1;
+}
+
+// Destructor for the maze loaded into a ServedMaze, the slot becomes unused
+void served_maze_dtor(ServedMaze *maze)
+{
+    if(maze->fileName == NULL){
+        return;
+    }
+    if(maze->hasField){
+        distance_field_dtor(&maze->field);
+    }
+    graph_dtor(&maze->graph);
+    map_worker_copies_dtor(maze->map, maze->workspaceCount, maze->workerMaps);
+    map_dtor(&maze->map);
+    for(int workspace = 0; workspace < maze->workspaceCount; workspace++){
+        workspace_dtor(&maze->workspaces[workspace]);
+    }
+    free(maze->workspaces);
+    maze->workspaces = NULL;
+    free(maze->workerMaps);
+    maze->workerMaps = NULL;
+    free(maze->fileName);
+    maze->fileName = NULL;
+}
+
+// Loads fileName into maze, a slot reserved by served_maze_open, returns -1 if the file can't be read
+int served_maze_load(ServedMaze *maze, const char *fileName, int workerCount)
+{
+    maze->graph = NULL;
+    maze->hasField = false;
+    maze->workspaceCount = 0;
+    maze->workspaces = malloc(sizeof(SearchWorkspace) * (size_t)workerCount);
+    maze->workerMaps = malloc(sizeof(Map *) * (size_t)workerCount);
+    if(maze->workspaces == NULL || maze->workerMaps == NULL){
+        fprintf(stderr, "Malloc failed\n");
+    }
+    if(maze->workspaces == NULL || maze->workerMaps == NULL || map_ctor(&maze->map, fileName) == -1
+       || map_worker_copies(maze->map, workerCount, maze->workerMaps) == -1){
+        map_dtor(&maze->map);
+        free(maze->workspaces);
+        maze->workspaces = NULL;
+        free(maze->workerMaps);
+        maze->workerMaps = NULL;
         return -1;
     }
+    maze->hasField = distance_field_load(&maze->field, fileName) == 0;
+    maze->workspaceCount = workerCount;
+    for(int workspace = 0; workspace < workerCount; workspace++){
+        workspace_ctor(&maze->workspaces[workspace], (int64_t)maze->map->rows * maze->map->cols);
+    }
+    return 0;
+}
 
-    Triangle triangle; 
-    Triangle iterTriangle;
+//
+// Returns the loaded maze of fileName for a request, it's loaded into the least recently used slot nobody uses
+// unless it's already there with the same size and modification time. The maze has to be given back by
+// served_maze_release. Returns NULL if the file can't be read
+//
+ServedMaze *served_maze_open(Server *server, const char *fileName, uint64_t requestNumber)
+{
+    int64_t sourceSize, sourceModified;
+    if(sidecar_source(fileName, &sourceSize, &sourceModified) == -1){
+        fprintf(stderr, "Error opening file %s\n", fileName);
+        return NULL;
+    }
+    char *name = malloc(strlen(fileName) + 1);
+    if(name == NULL){
+        fprintf(stderr, "Malloc failed\n");
+        return NULL;
+    }
+    strcpy(name, fileName);
 
-    // Check left/right
-    for(int row = 1; row <= map->rows; row++){
-        for(int col = 2; col <= map->cols; col++){
-            initialize_triangle(map, &triangle, row, col); // One ahead 
-            initialize_triangle(map, &iterTriangle, row, col-1); // One behind
-            if(isborder(map, iterTriangle.pos.r, iterTriangle.pos.c, R) != isborder(map, triangle.pos.r, triangle.pos.c, L)){
-                fprintf(stderr, "Error borders aren't defined correctly\n");
-                map_dtor(&map);
-                return -1;
+    pthread_mutex_lock(&server->lock);
+    ServedMaze *maze = NULL, *unused = NULL;
+    while(true){
+        ServedMaze *loading = NULL;
+        unused = NULL;
+        for(int slot = 0; slot < SERVE_MAZE_LIMIT && maze == NULL; slot++){
+            ServedMaze *current = &server->mazes[slot];
+            if(current->fileName != NULL && strcmp(current->fileName, fileName) == 0
+               && current->sourceSize == sourceSize && current->sourceModified == sourceModified){
+                if(current->isLoading){
+                    loading = current;
+                } else {
+                    maze = current;
+                }
+            } else if(current->users == 0 && (unused == NULL || (unused->fileName != NULL
+                      && (current->fileName == NULL || current->lastUsed < unused->lastUsed)))){
+                // Unused slots have never been used
+                unused = current;
             }
         }
-    }
-    
-    // Check Up/Down
-    for(int row = 2; row <= map->rows; row++){
-        for(int col = 1; col <= map->cols; col++){
-            initialize_triangle(map, &triangle, row-1, col); // above iterTriangle
-            initialize_triangle(map, &iterTriangle, row, col); // underneath triangle
-            if(determine_triangle_type(triangle.pos) == CONTAINS_DOWN && determine_triangle_type(iterTriangle.pos) == CONTAINS_UP){
-                if(isborder(map, iterTriangle.pos.r, iterTriangle.pos.c, U) != isborder(map, triangle.pos.r, triangle.pos.c, D)){
-                    fprintf(stderr, "Error borders aren't defined correctly\n");
-                    map_dtor(&map);
-                    return -1;
-                }
+        if(maze != NULL || (loading == NULL && unused != NULL)){
+            break;
+        }
+        pthread_cond_wait(&server->mazeChanged, &server->lock);
+    }
+    if(maze != NULL){
+        maze->users++;
+        maze->lastUsed = requestNumber;
+        pthread_mutex_unlock(&server->lock);
+        free(name);
+        return maze;
+    }
+
+    // Requests for the same file wait while the slot is loading, so it's loaded without holding the lock
+    maze = unused;
+    served_maze_dtor(maze);
+    maze->fileName = name;
+    maze->sourceSize = sourceSize;
+    maze->sourceModified = sourceModified;
+    maze->lastUsed = requestNumber;
+    maze->users = 1;
+    maze->isLoading = true;
+    pthread_mutex_unlock(&server->lock);
+
+    int result = served_maze_load(maze, fileName, server->workerCount);
+
+    pthread_mutex_lock(&server->lock);
+    maze->isLoading = false;
+    if(result == -1){
+        maze->users = 0;
+        free(maze->fileName);
+        maze->fileName = NULL;
+    }
+    pthread_cond_broadcast(&server->mazeChanged);
+    pthread_mutex_unlock(&server->lock);
+    return result == 0 ? maze : NULL;
+}
+
+// Gives back a maze taken by served_maze_open
+void served_maze_release(Server *server, ServedMaze *maze)
+{
+    pthread_mutex_lock(&server->lock);
+    if(--maze->users == 0){
+        pthread_cond_broadcast(&server->mazeChanged);
+    }
+    pthread_mutex_unlock(&server->lock);
+}
+//
+// Answers a single request line of --serve into sink, line has its trailing whitespace removed and ends with '\0'
+// Lines are "test FILE" or "MODE R C FILE" with MODE from queryModeNames, the answer is "> LINE", the path
+// (or Valid / Invalid for test) and "< RESULT" with RESULT from searchResultNames
+// Runs on a worker, a sink writing into the socket sends the path while it's still being searched
+//
+void serve_request(Server *server, const char *line, uint64_t requestNumber, int workerIndex, PathSink *sink)
+{
+    size_t lineLength = strlen(line);
+    path_sink_write(sink, "> ", 2);
+    path_sink_write(sink, line, lineLength);
+    path_sink_write(sink, "\n", 1);
+
+    const char *lineEnd = line + lineLength;
+    const char *nameEnd = line;
+    while(nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t'){
+        nameEnd++;
+    }
+    Query query = {QUERY_INVALID, 0, 0};
+    for(int modeIndex = QUERY_RPATH; modeIndex < QUERY_INVALID; modeIndex++){
+        if(strlen(queryModeNames[modeIndex]) == (size_t)(nameEnd - line) && strncmp(line, queryModeNames[modeIndex], nameEnd - line) == 0){
+            query.mode = modeIndex;
+        }
+    }
+    bool isTest = nameEnd - line == 4 && strncmp(line, "test", 4) == 0;
+
+    const char *fileName = nameEnd;
+    if(query.mode != QUERY_INVALID && (scan_int(&fileName, lineEnd, &query.r) == -1 || scan_int(&fileName, lineEnd, &query.c) == -1)){
+        query.mode = QUERY_INVALID;
+    }
+    while(fileName < lineEnd && (*fileName == ' ' || *fileName == '\t')){
+        fileName++;
+    }
+    if((!isTest && query.mode == QUERY_INVALID) || fileName == lineEnd){
+        fprintf(stderr, "Error request couldn't be parsed\n");
+        path_sink_query_footer(sink, SEARCH_ERROR);
+        return;
+    }
+
+    ServedMaze *maze = served_maze_open(server, fileName, requestNumber);
+    if(isTest){
+        // Same rules as test_file, a file which can't be read is invalid
+        bool isValid = maze != NULL && maze->map->rows != maze->map->cols && maze->map->validity == MAZE_VALID;
+        path_sink_write(sink, isValid ? "Valid\n" : "Invalid\n", isValid ? 6 : 8);
+        path_sink_query_footer(sink, SEARCH_FOUND);
+    } else {
+        int result = SEARCH_ERROR;
+        bool hasGraph = maze != NULL && (query.mode != QUERY_SHORTEST || maze->hasField);
+        if(maze != NULL && !hasGraph){
+            pthread_mutex_lock(&maze->graphLock);
+            hasGraph = maze->graph != NULL || graph_ctor(&maze->graph, maze->map) == 0;
+            pthread_mutex_unlock(&maze->graphLock);
+        }
+        if(hasGraph){
+            result = run_query(maze->workerMaps[workerIndex], maze->graph, maze->hasField ? &maze->field : NULL,
+                               &maze->workspaces[workerIndex], &query, sink);
+        }
+        path_sink_query_footer(sink, result);
+    }
+    if(maze != NULL){
+        served_maze_release(server, maze);
+    }
+}
+
+//
+// Task of the WorkerPool of --serve, a single task keeps answering queued clients until the server stops
+// The answer is written straight into the socket of the client, its sink only buffers PATH_SINK_CAPACITY bytes
+//
+void serve_worker(void *context, int taskIndex, int workerIndex)
+{
+    Server *server = context;
+    (void)taskIndex;
+    // A pool without threads runs its tasks on the event loop, which would never get to queue a job
+    if(pthread_equal(pthread_self(), server->loopThread)){
+        return;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    while(true){
+        while(!server->isStopping && server->jobs == NULL){
+            pthread_cond_wait(&server->jobQueued, &server->lock);
+        }
+        if(server->isStopping){
+            break;
+        }
+        ServeClient *client = server->jobs;
+        server->jobs = client->nextJob;
+        pthread_mutex_unlock(&server->lock);
+
+        PathSink sink;
+        client->failed = path_sink_ctor(&sink, client->fd, PATH_TEXT) == -1;
+        if(!client->failed){
+            serve_request(server, client->request, client->requestNumber, workerIndex, &sink);
+            client->failed = path_sink_dtor(&sink) == -1;
+        }
 
-            }
+        pthread_mutex_lock(&server->lock);
+        client->nextJob = server->finished;
+        server->finished = client;
+        uint64_t wake = 1;
+        if(write(server->wakeFd, &wake, sizeof(wake)) == -1){
+            // Counter of an eventfd only fails to grow once it's about to overflow, the event loop is woken anyway
         }
     }
-    map_dtor(&map);
-    return 0;
+    pthread_mutex_unlock(&server->lock);
 }
 
-// TODO better remake for mazeboundary limit iterations
-int start_border(Map *map, int r, int c, int leftright)
+// Registers client in epoll for incoming lines, or takes it out while it's busy, returns -1 on failure
+int serve_client_watch(int epoll, ServeClient *client, bool isWatched)
 {
-    Triangle chosenTriangle;
-    initialize_triangle(map, &chosenTriangle, r, c);
-    if(chosenTriangle.mazeBoundary == 0){
-        fprintf(stderr, "Error wrong args R and C -> cannot start in the middle\n");
+    if(client->isWatched == isWatched){
+        return 0;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+    if(epoll_ctl(epoll, isWatched ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, client->fd, &event) == -1){
+        fprintf(stderr, "Error watching client socket\n");
         return -1;
     }
+    client->isWatched = isWatched;
+    return 0;
+}
 
-    Direction changeDirection[4];
-    Direction dirOrder[] = {0, L, R, U, D};;
-    Direction rpathOrder[] = {0, R, L, D};
-    Direction lpathOrder[] = {0, L, R, U};
-
-    // Adjusts for triangle properties and move orders rpath == lpath in downpointing triangle where .type == CONTAINS_UP 
-    if(leftright == L){
-        if(chosenTriangle.type == CONTAINS_UP){
-            memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-            changeDirection[3] = U;
+//
+// Queues the next complete line of client for a worker, lines without a request are skipped
+// A client is busy and isn't read until its answer is sent, so answers keep the order of requests
+// Returns -1 once the client should be closed
+//
+int serve_client_next(Server *server, uint64_t *requestCount, int epoll, ServeClient *client)
+{
+    char *line = client->input, *inputEnd = client->input + client->inputUsed;
+    for(char *lineEnd; (lineEnd = memchr(line, '\n', inputEnd - line)) != NULL; line = lineEnd + 1){
+        char *trimmed = lineEnd;
+        while(trimmed > line && (trimmed[-1] == ' ' || trimmed[-1] == '\t' || trimmed[-1] == '\r')){
+            trimmed--;
+        }
+        *trimmed = '\0';
+        char *request = line;
+        while(*request == ' ' || *request == '\t'){
+            request++;
         }
-        else{
-            memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-            changeDirection[3] = D;
+        if(*request == '\0' || *request == '#'){
+            continue;
         }
 
-    } else if(leftright == R){
-        if(chosenTriangle.type == CONTAINS_UP){
-            memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-            changeDirection[3] = U;
+        client->inputUsed = inputEnd - line;
+        memmove(client->input, line, client->inputUsed);
+        client->request = client->input + (request - line);
+        client->requestLength = lineEnd + 1 - line;
+        client->requestNumber = ++*requestCount;
+        if(serve_client_watch(epoll, client, false) == -1){
+            return -1;
         }
-        else{
-            memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-            changeDirection[3] = D;
+        pthread_mutex_lock(&server->lock);
+        client->nextJob = NULL;
+        if(server->jobs == NULL){
+            server->jobs = client;
+        } else {
+            server->lastJob->nextJob = client;
         }
+        server->lastJob = client;
+        pthread_cond_signal(&server->jobQueued);
+        pthread_mutex_unlock(&server->lock);
+        return 0;
     }
-    
-    Direction entryDirection;
-    Direction resultDirection = 0;
-    const int adjustForPath = 1; 
-    for(int iterateDirs = 1; iterateDirs < NUM_OF_DIRECTIONS; iterateDirs++)
-    {
-        if(isborder(map, r, c, dirOrder[iterateDirs]) == 0 && is_maze_boundary(chosenTriangle, dirOrder[iterateDirs]) == 1){
-            entryDirection = dirOrder[iterateDirs]; 
-            if(!((chosenTriangle.type == CONTAINS_UP && entryDirection == D) || (chosenTriangle.type == CONTAINS_DOWN && entryDirection == U))){
-                for(int directions = 1; directions < 4; directions++){
-                    // Change direction by +1 index of changeDirection arr
-                    if(entryDirection == changeDirection[directions]){
-                        // Prevent overflowing
-                        if(entryDirection == D || entryDirection == U){
-                            resultDirection = changeDirection[adjustForPath];
-                            return resultDirection;
-                        }
-                        // FOR R or L
-                        resultDirection = changeDirection[directions+adjustForPath];
-                        return resultDirection;
-                    }
 
-                }
-            }
-        }
+    client->inputUsed = inputEnd - line;
+    memmove(client->input, line, client->inputUsed);
+    if(client->inputUsed == SERVE_LINE_LIMIT){
+        fprintf(stderr, "Error request is longer than %d bytes\n", SERVE_LINE_LIMIT);
+        return -1;
     }
-
-    fprintf(stderr, "Error starting border couldn't be determined\n");
-    return -1;
+    return client->isClosing ? -1 : serve_client_watch(epoll, client, true);
 }
 
-// Used for --rpath a --lpath
-int search_maze(Map *map, int r, int c, int leftRight)
+// Reads what a --serve client sent and queues its next request, returns -1 once the client should be closed
+int serve_client(Server *server, uint64_t *requestCount, int epoll, ServeClient *client, uint32_t events)
 {
-    Triangle startPos;
-    initialize_triangle(map, &startPos, r, c);
-
-    int initialDirection = start_border(map, r, c, leftRight);
-    if(initialDirection == -1){
+    if(events & EPOLLIN){
+        ssize_t received = recv(client->fd, client->input + client->inputUsed, SERVE_LINE_LIMIT - client->inputUsed, 0);
+        if(received == 0){
+            client->isClosing = true;
+        } else if(received > 0){
+            client->inputUsed += (size_t)received;
+        } else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+            return -1;
+        }
+    } else if(events & (EPOLLERR | EPOLLHUP)){
         return -1;
     }
+    return serve_client_next(server, requestCount, epoll, client);
+}
 
-    Direction changeDirection[4];
-    Direction rpathOrder[] = {0, R, L, D};
-    Direction lpathOrder[] = {0, L, R, U};
-
-    //FIRST TRIANGLE
-
-    // Adjusts for triangle properties and move orders rpath == lpath in downpointing triangle where .type == CONTAINS_UP 
-    if(leftRight == L){
-        if(startPos.type == CONTAINS_UP){
-            memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-            changeDirection[3] = U;
-        }
-        else{
-            memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-            changeDirection[3] = D;
+// Accepts every pending connection of listener into clients, returns -1 on failure
+int serve_accept(int epoll, int listener, ServeClient **clients)
+{
+    while(true){
+        int fd = accept(listener, NULL, NULL);
+        if(fd == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED ? 0 : -1;
         }
 
-    } else if(leftRight == R){
-        if(startPos.type == CONTAINS_UP){
-            memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-            changeDirection[3] = U;
+        ServeClient *client = malloc(sizeof(ServeClient));
+        char *input = malloc(SERVE_LINE_LIMIT);
+        if(client == NULL || input == NULL){
+            fprintf(stderr, "Malloc failed on client\n");
+            free(client);
+            free(input);
+            close(fd);
+            continue;
+        }
+        *client = (ServeClient){.fd = fd, .input = input, .next = *clients};
+        if(fcntl(fd, F_SETFL, O_NONBLOCK) == -1 || serve_client_watch(epoll, client, true) == -1){
+            free(input);
+            free(client);
+            close(fd);
+            continue;
         }
-        else{
-            memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-            changeDirection[3] = D;
+        if(*clients != NULL){
+            (*clients)->previous = client;
         }
+        *clients = client;
     }
-    // finds index
+}
 
-    int initialIndex = 0;
-    for(int formulateIndex = 1; formulateIndex < 5; formulateIndex++){
-        if((Direction)initialDirection == changeDirection[formulateIndex]){
-            initialIndex = formulateIndex;
-            break;
-        }
+// Closes client and takes it out of clients, the client mustn't be busy
+void serve_close(ServeClient **clients, ServeClient *client)
+{
+    if(client->previous != NULL){
+        client->previous->next = client->next;
+    } else {
+        *clients = client->next;
     }
+    if(client->next != NULL){
+        client->next->previous = client->previous;
+    }
+    close(client->fd);
+    free(client->input);
+    free(client);
+}
 
-    if(initialIndex == 0){
+//
+// Takes back the clients answered by workers, the answered line is dropped and the next one is queued
+// Returns -1 on failure
+//
+int serve_finished(Server *server, uint64_t *requestCount, int epoll, ServeClient **clients)
+{
+    uint64_t wakes;
+    if(read(server->wakeFd, &wakes, sizeof(wakes)) == -1 && errno != EAGAIN){
         return -1;
     }
-    // Initial direction isn't in a border way
-    while(isborder(map, r, c, changeDirection[initialIndex]) != 0){
-        if(initialIndex == 3){
-            initialIndex = 1;
-        } else {
-            initialIndex++;
+    pthread_mutex_lock(&server->lock);
+    ServeClient *finished = server->finished;
+    server->finished = NULL;
+    pthread_mutex_unlock(&server->lock);
+
+    while(finished != NULL){
+        ServeClient *client = finished;
+        finished = client->nextJob;
+        client->inputUsed -= client->requestLength;
+        memmove(client->input, client->input + client->requestLength, client->inputUsed);
+        client->request = NULL;
+        if(client->failed || serve_client_next(server, requestCount, epoll, client) == -1){
+            serve_close(clients, client);
         }
+    }
+    return 0;
+}
 
+//
+// Binds a listening Unix socket to socketPath, a socket file left behind by a server that isn't running
+// any more is replaced. Returns the socket or -1 on failure
+//
+int serve_listen(const char *socketPath)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(strlen(socketPath) >= sizeof(address.sun_path)){
+        fprintf(stderr, "Error socket path %s is too long\n", socketPath);
+        return -1;
     }
-    initialDirection = changeDirection[initialIndex];
+    strcpy(address.sun_path, socketPath);
 
-    // Whole maze
-    int foundPath = 0;
-    int dirIndex = 0;
-    for(int formulateIndex = 1; formulateIndex < 5; formulateIndex++){
-        if((Direction)initialDirection == changeDirection[formulateIndex]){
-            dirIndex = formulateIndex;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener == -1){
+        fprintf(stderr, "Error creating socket\n");
+        return -1;
+    }
+    int result = bind(listener, (struct sockaddr *)&address, sizeof(address));
+    if(result == -1 && errno == EADDRINUSE){
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool isStale = probe != -1 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == -1 && errno == ECONNREFUSED;
+        if(probe != -1){
+            close(probe);
+        }
+        if(isStale && unlink(socketPath) == 0){
+            result = bind(listener, (struct sockaddr *)&address, sizeof(address));
+        } else {
+            errno = EADDRINUSE;
         }
     }
-    
-    Triangle newPos;
-
-    if(initialize_triangle(map, &newPos, startPos.pos.r, startPos.pos.c) == -1){
-        fprintf(stderr, "Error initializing inside path finding\n");
+    if(result == -1 || listen(listener, SOMAXCONN) == -1 || fcntl(listener, F_SETFL, O_NONBLOCK) == -1){
+        fprintf(stderr, errno == EADDRINUSE ? "Error socket %s is in use\n" : "Error listening on %s\n", socketPath);
+        close(listener);
         return -1;
     }
+    return listener;
+}
 
-    foundPath = 0;
-    printf("%d,%d\n",startPos.pos.r,startPos.pos.c);
-    int prevIndex = initialIndex;
-    dirIndex = prevIndex;
-    while(1){
-        foundPath = triangle_move_in(map, newPos, &newPos, changeDirection[dirIndex]);
-        if(dirIndex == 0){
-            fprintf(stderr, "Error path finding couldn't continue\n");
-            return -1;
+//
+// Used for --serve, answers request lines of every client connected to the Unix socket socketPath until SIGINT or SIGTERM
+// Mazes stay loaded between requests, so a request only pays for its search. The calling thread only accepts clients
+// and reads their lines, requests are answered by threadCount workers so a long search doesn't hold up other clients.
+// A client has a single request answered at a time, answers come back in the order of its lines. Returns -1 on failure
+//
+int serve(const char *socketPath)
+{
+    // Answers are framed by lines, paths of the other formats can't be told apart from them
+    if(pathFormat != PATH_TEXT){
+        fprintf(stderr, "Error --serve supports only the text format\n");
+        return -1;
+    }
+    int listener = serve_listen(socketPath);
+    if(listener == -1){
+        return -1;
+    }
+    Server server = {.workerCount = threadCount, .loopThread = pthread_self()};
+    server.wakeFd = eventfd(0, EFD_NONBLOCK);
+    int epoll = epoll_create1(0);
+    struct epoll_event listenerEvent = {.events = EPOLLIN, .data.ptr = NULL};
+    struct epoll_event wakeEvent = {.events = EPOLLIN, .data.ptr = &server};
+    if(server.wakeFd == -1 || epoll == -1 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &listenerEvent) == -1
+       || epoll_ctl(epoll, EPOLL_CTL_ADD, server.wakeFd, &wakeEvent) == -1){
+        fprintf(stderr, "Error creating epoll instance\n");
+        if(epoll != -1){
+            close(epoll);
         }
+        if(server.wakeFd != -1){
+            close(server.wakeFd);
+        }
+        close(listener);
+        unlink(socketPath);
+        return -1;
+    }
 
-        if(foundPath == -1){
-            // At the end of arr
-            if(dirIndex == 3){
-                dirIndex = 1;
-            } else {
-                dirIndex++;
-            }
-
-        } else if(foundPath == -1 && dirIndex == prevIndex){
-            
+    // No SA_RESTART, epoll_wait returns as soon as a signal arrives
+    struct sigaction stopAction = {.sa_handler = serve_stop};
+    sigemptyset(&stopAction.sa_mask);
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+    // A client gone before its answer is sent fails the write instead of killing the server
+    signal(SIGPIPE, SIG_IGN);
 
-        } else if(foundPath == 0){
-            printf("%d,%d\n", newPos.pos.r, newPos.pos.c);
-            // Set right changeDirection array
-            if(leftRight == L){
-                if(newPos.type == CONTAINS_UP){
-                    memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-                    changeDirection[3] = U;
-                }
-                else{
-                    memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-                    changeDirection[3] = D;
-                }
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.mazeChanged, NULL);
+    pthread_cond_init(&server.jobQueued, NULL);
+    for(int slot = 0; slot < SERVE_MAZE_LIMIT; slot++){
+        pthread_mutex_init(&server.mazes[slot].graphLock, NULL);
+    }
 
-            } else if(leftRight == R){
-                if(newPos.type == CONTAINS_UP){
-                    memcpy(changeDirection, lpathOrder, sizeof(changeDirection));
-                    changeDirection[3] = U;
-                }
-                else{
-                    memcpy(changeDirection, rpathOrder, sizeof(changeDirection));
-                    changeDirection[3] = D;
-                }
-            }
-            dirIndex = prevIndex;
-            while(1){
+    // Every worker keeps taking jobs until the server stops, so there is a single task per worker
+    WorkerPool pool;
+    int result = worker_pool_start(&pool, server.workerCount, server.workerCount, serve_worker, &server);
+    bool hasPool = result == 0;
+    if(hasPool && pool.startedCount == 0){
+        fprintf(stderr, "Error --serve needs at least one worker thread\n");
+        result = -1;
+    }
 
-                if(dirIndex == 3){
-                    dirIndex = 1;
-                } else {
-                    dirIndex++;
-                }
-                if(isborder(map, newPos.pos.r, newPos.pos.c, changeDirection[dirIndex]) == 0){
-                    break;
-                }
+    ServeClient *clients = NULL;
+    uint64_t requestCount = 0;
+    while(!serveStopped && result == 0){
+        struct epoll_event events[SERVE_EVENTS];
+        int eventCount = epoll_wait(epoll, events, SERVE_EVENTS, -1);
+        if(eventCount == -1 && errno != EINTR){
+            fprintf(stderr, "Error waiting for clients\n");
+            result = -1;
+        }
+        for(int eventIndex = 0; eventIndex < eventCount && result == 0; eventIndex++){
+            void *source = events[eventIndex].data.ptr;
+            if(source == NULL){
+                result = serve_accept(epoll, listener, &clients);
+            } else if(source == &server){
+                result = serve_finished(&server, &requestCount, epoll, &clients);
+            } else if(serve_client(&server, &requestCount, epoll, source, events[eventIndex].events) == -1){
+                serve_close(&clients, source);
             }
-            prevIndex = dirIndex;
-            
+        }
+    }
 
-        } else if(foundPath == -2){
-            fprintf(stderr, "Error path finding couldn't continue\n");
-            return -1;
-        } else if(foundPath == 1){
-            break;
+    // Workers stuck sending to a client that doesn't read are released by shutting its socket down
+    pthread_mutex_lock(&server.lock);
+    server.isStopping = true;
+    pthread_cond_broadcast(&server.jobQueued);
+    pthread_mutex_unlock(&server.lock);
+    for(ServeClient *client = clients; client != NULL; client = client->next){
+        if(client->request != NULL){
+            shutdown(client->fd, SHUT_RDWR);
         }
     }
-    return 0;
-    
+    if(hasPool){
+        worker_pool_join(&pool);
+    }
 
+    while(clients != NULL){
+        serve_close(&clients, clients);
+    }
+    for(int slot = 0; slot < SERVE_MAZE_LIMIT; slot++){
+        served_maze_dtor(&server.mazes[slot]);
+        pthread_mutex_destroy(&server.mazes[slot].graphLock);
+    }
+    pthread_cond_destroy(&server.jobQueued);
+    pthread_cond_destroy(&server.mazeChanged);
+    pthread_mutex_destroy(&server.lock);
+    close(server.wakeFd);
+    close(epoll);
+    close(listener);
+    unlink(socketPath);
+    return result;
 }
 
 int main(int argc, char *argv[])
@@ -704,18 +7180,107 @@ int main(int argc, char *argv[])
     // Variables used, Global Variable Map *map; is also being used
     int posR = 0, posC = 0; // check if they're set correctly
     const char *fileName;
-    Map *map;
+    Map *map = NULL;
 
-    // REMAKE
+    transition_table_init();
+
+    // Options which go before the mode
     int argNum = 1;
-        if(argc == 2 && strcmp(argv[argNum], "--help") == 0){
+    while(argNum < argc - 1){
+        if(strcmp(argv[argNum], "--verbose") == 0){
+            verboseOutput = true;
+        } else if(strcmp(argv[argNum], "--stats") == 0){
+            if(!MAZE_STATS){
+                fprintf(stderr, "Error --stats isn't available, the program was built with MAZE_STATS=0\n");
+                return EXIT_FAILURE;
+            }
+            if(!statsOutput){
+                atexit(stats_print);
+            }
+            statsOutput = true;
+        } else if(strcmp(argv[argNum], "--format") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            if(strcmp(argv[argNum], "text") == 0){
+                pathFormat = PATH_TEXT;
+            } else if(strcmp(argv[argNum], "binary") == 0){
+                pathFormat = PATH_BINARY;
+            } else if(strcmp(argv[argNum], "length") == 0){
+                pathFormat = PATH_LENGTH;
+            } else if(strcmp(argv[argNum], "packed") == 0){
+                pathFormat = PATH_PACKED;
+            } else if(strcmp(argv[argNum], "rle") == 0){
+                pathFormat = PATH_PACKED_RLE;
+            } else {
+                fprintf(stderr, "Error unknown path format %s see --help\n", argv[argNum]);
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[argNum], "--storage") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            if(strcmp(argv[argNum], "bytes") == 0){
+                mapStorage = MAP_STORAGE_BYTES;
+            } else if(strcmp(argv[argNum], "planes") == 0){
+                mapStorage = MAP_STORAGE_PLANES;
+            } else if(strcmp(argv[argNum], "tiles") == 0){
+                mapStorage = MAP_STORAGE_TILES;
+            } else {
+                fprintf(stderr, "Error unknown storage %s see --help\n", argv[argNum]);
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[argNum], "--search") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            if(strcmp(argv[argNum], "bfs") == 0){
+                searchStrategy = SEARCH_BFS;
+            } else if(strcmp(argv[argNum], "bidirectional") == 0){
+                searchStrategy = SEARCH_BIDIRECTIONAL;
+            } else if(strcmp(argv[argNum], "astar") == 0){
+                searchStrategy = SEARCH_ASTAR;
+            } else {
+                fprintf(stderr, "Error unknown search %s see --help\n", argv[argNum]);
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[argNum], "--threads") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            char *end;
+            long threads = strtol(argv[argNum], &end, 10);
+            if(*end != '\0' || threads < 1 || threads > 1024){
+                fprintf(stderr, "Error --threads has to be a number from 1 to 1024\n");
+                return EXIT_FAILURE;
+            }
+            threadCount = (int)threads;
+        } else if(strcmp(argv[argNum], "--memory-budget") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            char *end;
+            long budget = strtol(argv[argNum], &end, 10);
+            if(*end != '\0' || budget < 1 || budget > 1048576){
+                fprintf(stderr, "Error --memory-budget has to be a number of MiB from 1 to 1048576\n");
+                return EXIT_FAILURE;
+            }
+            tileBudget = (int)budget;
+        } else if(strcmp(argv[argNum], "--with-graph") == 0){
+            compileGraph = true;
+        } else if(strcmp(argv[argNum], "--max-steps") == 0 && argNum + 1 < argc - 1){
+            argNum++;
+            char *end;
+            maxSteps = strtoll(argv[argNum], &end, 10);
+            if(*end != '\0' || maxSteps < 1){
+                fprintf(stderr, "Error --max-steps has to be a positive number\n");
+                return EXIT_FAILURE;
+            }
+        } else {
+            break;
+        }
+        argNum++;
+    }
+    int modeArgs = argc - argNum; // Mode and its arguments
+
+        if(modeArgs == 1 && strcmp(argv[argNum], "--help") == 0){
             printHelp();
             return EXIT_SUCCESS;
         }
         
         // RUNS --test
         if(strcmp(argv[argNum], "--test") == 0){
-            if(argc != 3){
+            if(modeArgs != 2){
                 fprintf(stderr, "Error wrong number of arguments given see --help\n");
                 return EXIT_FAILURE;
             }
@@ -724,27 +7289,213 @@ int main(int argc, char *argv[])
             return EXIT_SUCCESS;
         }
 
-        // RUNS --rpath with R dir
-        if(strcmp(argv[argNum], "--rpath") == 0){
-            if(argc != 5){
+        // RUNS --test-many
+        if(strcmp(argv[argNum], "--test-many") == 0){
+            if(modeArgs < 2){
                 fprintf(stderr, "Error wrong number of arguments given see --help\n");
                 return EXIT_FAILURE;
             }
-            posR = atoi(argv[argNum+1]);
-            posC = atoi(argv[argNum+2]);
-            fileName = argv[argNum+3];
+            return test_many(argv + argNum + 1, modeArgs - 1) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --components
+        if(strcmp(argv[argNum], "--components") == 0){
+            if(modeArgs != 2){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum+1];
 
-            test(fileName);
             if(map_ctor(&map, fileName) == -1){
                 return EXIT_FAILURE;
             }
-            search_maze(map, posR, posC, R);
+            Components components;
+            int result = components_build(&components, map);
+            map_dtor(&map);
+            if(result == -1){
+                return EXIT_FAILURE;
+            }
 
+            uint32_t leadingOut = 0;
+            for(uint32_t label = 0; label < components.componentCount; label++){
+                leadingOut += components.info[label].exits > 0;
+            }
+            result = components_write(&components, fileName);
+            if(result == 0){
+                printf("%u components, %u leading outside of the maze\n", components.componentCount, leadingOut);
+            }
+            components_dtor(&components);
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
         }
-    
-        // RUNS --lpath with L dir
-        if(strcmp(argv[argNum], "--lpath") == 0){
-            if(argc != 5){
+
+        // RUNS --distance-field
+        if(strcmp(argv[argNum], "--distance-field") == 0){
+            if(modeArgs != 2){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum+1];
+
+            if(map_ctor(&map, fileName) == -1){
+                return EXIT_FAILURE;
+            }
+            Graph *graph;
+            DistanceField field;
+            int result = graph_ctor(&graph, map);
+            if(result == 0){
+                result = distance_field_build(&field, map, graph);
+                graph_dtor(&graph);
+            }
+            map_dtor(&map);
+            if(result == -1){
+                return EXIT_FAILURE;
+            }
+
+            int exits = 0, leadingOut = 0;
+            uint32_t longest = 0;
+            for(int cellIndex = 0; cellIndex < field.rows * field.cols; cellIndex++){
+                uint32_t moves = field.distance[0][cellIndex];
+                exits += moves == 0;
+                leadingOut += moves != DISTANCE_UNREACHABLE;
+                longest = moves != DISTANCE_UNREACHABLE && moves > longest ? moves : longest;
+            }
+            result = distance_field_write(&field, fileName);
+            if(result == 0){
+                printf("%d exits, %d triangles leading outside of the maze, the furthest one %u moves away\n", exits, leadingOut, longest);
+            }
+            distance_field_dtor(&field);
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --corridors
+        if(strcmp(argv[argNum], "--corridors") == 0){
+            if(modeArgs != 2){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum+1];
+
+            if(map_ctor(&map, fileName) == -1){
+                return EXIT_FAILURE;
+            }
+            if(map->validity != MAZE_VALID){
+                fprintf(stderr, "Error corridors can't be built for an invalid maze\n");
+                map_dtor(&map);
+                return EXIT_FAILURE;
+            }
+            Corridors corridors;
+            int result = corridors_build(&corridors, map);
+            map_dtor(&map);
+            if(result == -1){
+                return EXIT_FAILURE;
+            }
+
+            long long inside = 0;
+            for(uint32_t label = 0; label < corridors.corridorCount; label++){
+                inside += corridors.corridors[label].length - 1;
+            }
+            result = corridors_write(&corridors, fileName);
+            if(result == 0){
+                printf("%u corridors holding %lld triangles, crossed in one move by --format length\n", corridors.corridorCount, inside);
+            }
+            corridors_dtor(&corridors);
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --serve
+        if(strcmp(argv[argNum], "--serve") == 0){
+            if(modeArgs != 2){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            return serve(argv[argNum+1]) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --decode-path
+        if(strcmp(argv[argNum], "--decode-path") == 0){
+            if(modeArgs != 2){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            PathSink sink;
+            if(path_sink_ctor(&sink, STDOUT_FILENO, pathFormat) == -1){
+                return EXIT_FAILURE;
+            }
+            int result = decode_path(argv[argNum+1], &sink);
+            if(path_sink_dtor(&sink) == -1){
+                result = -1;
+            }
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --apply-patch
+        if(strcmp(argv[argNum], "--apply-patch") == 0){
+            if(modeArgs != 3){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            return apply_patches(argv[argNum+1], argv[argNum+2]) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --compile
+        if(strcmp(argv[argNum], "--compile") == 0){
+            if(modeArgs != 3){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum+1];
+
+            if(map_ctor(&map, fileName) == -1){
+                return EXIT_FAILURE;
+            }
+            Components components;
+            Graph *graph = NULL;
+            int result = components_build(&components, map);
+            if(result == 0 && compileGraph && graph_ctor(&graph, map) == -1){
+                components_dtor(&components);
+                result = -1;
+            }
+            if(result == 0){
+                result = tmaze_write(map, &components, graph, argv[argNum+2]);
+                components_dtor(&components);
+            }
+            graph_dtor(&graph);
+            map_dtor(&map);
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        // RUNS --viable and --reachable
+        if(strcmp(argv[argNum], "--viable") == 0 || strcmp(argv[argNum], "--reachable") == 0){
+            bool isViable = strcmp(argv[argNum], "--viable") == 0;
+            if(modeArgs != (isViable ? 4 : 6)){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum + modeArgs - 1];
+
+            Components components;
+            if(components_open(&components, fileName) == -1){
+                return EXIT_FAILURE;
+            }
+            int first = components_cell(&components, atoi(argv[argNum+1]), atoi(argv[argNum+2]));
+            int second = isViable ? first : components_cell(&components, atoi(argv[argNum+3]), atoi(argv[argNum+4]));
+            if(first == -1 || second == -1){
+                components_dtor(&components);
+                return EXIT_FAILURE;
+            }
+
+            if(isViable){
+                printf("%s\n", components_viable(&components, first) ? "Viable" : "Not viable");
+            } else {
+                printf("%s\n", components_reachable(&components, first, second) ? "Reachable" : "Unreachable");
+            }
+            components_dtor(&components);
+            return EXIT_SUCCESS;
+        }
+
+        // RUNS --rpath with R dir, --lpath with L dir or --shortest
+        if(strcmp(argv[argNum], "--rpath") == 0 || strcmp(argv[argNum], "--lpath") == 0 || strcmp(argv[argNum], "--shortest") == 0){
+            if(modeArgs != 4){
                 fprintf(stderr, "Error wrong number of arguments given see --help\n");
                 return EXIT_FAILURE;
             }
@@ -752,16 +7503,102 @@ int main(int argc, char *argv[])
             posC = atoi(argv[argNum+2]);
             fileName = argv[argNum+3];
 
-            // TESTING
-            test(fileName);
+            // Walks of the hand rule on tiles never index cells with int, unlike everything --shortest builds
+            if(strcmp(argv[argNum], "--shortest") != 0 && mapStorage == MAP_STORAGE_TILES){
+                cellLimit = TILED_CELL_LIMIT;
+            }
+
+            // An up to date distances sidecar answers --shortest without loading the maze at all
+            DistanceField field;
+            bool hasField = strcmp(argv[argNum], "--shortest") == 0 && distance_field_load(&field, fileName) == 0;
+            if(!hasField && map_ctor(&map, fileName) == -1){
+                return EXIT_FAILURE;
+            }
+
+            PathSink sink;
+            if(path_sink_ctor(&sink, STDOUT_FILENO, pathFormat) == -1){
+                if(hasField){
+                    distance_field_dtor(&field);
+                }
+                map_dtor(&map);
+                return EXIT_FAILURE;
+            }
+
+            int result;
+            if(hasField){
+                result = distance_field_path(&field, posR, posC, &sink);
+                distance_field_dtor(&field);
+            } else {
+                SearchWorkspace workspace;
+                workspace_ctor(&workspace, (int64_t)map->rows * map->cols);
+                if(strcmp(argv[argNum], "--shortest") == 0){
+                    Graph *graph;
+                    if(graph_ctor(&graph, map) == -1){
+                        result = SEARCH_ERROR;
+                    } else {
+                        result = shortest_path(map, graph, &workspace, posR, posC, &sink);
+                        graph_dtor(&graph);
+                    }
+                } else {
+                    Corridors corridors;
+                    bool hasCorridors = corridors_open(&corridors, map, fileName) == 0;
+                    result = search_maze(map, hasCorridors ? &corridors : NULL, &workspace, posR, posC, strcmp(argv[argNum], "--rpath") == 0 ? R : L, &sink);
+                    if(hasCorridors){
+                        corridors_dtor(&corridors);
+                    }
+                }
+                workspace_dtor(&workspace);
+            }
+
+            if(path_sink_dtor(&sink) == -1){
+                result = SEARCH_ERROR;
+            }
+            map_dtor(&map);
+
+            switch(result){
+                case SEARCH_FOUND:
+                    return EXIT_SUCCESS;
+                case SEARCH_LOOPED:
+                    return EXIT_LOOPED;
+                case SEARCH_STEP_LIMIT:
+                    return EXIT_STEP_LIMIT;
+                default:
+                    return EXIT_FAILURE;
+            }
+        }
+
+        // RUNS --batch
+        if(strcmp(argv[argNum], "--batch") == 0){
+            if(modeArgs != 3){
+                fprintf(stderr, "Error wrong number of arguments given see --help\n");
+                return EXIT_FAILURE;
+            }
+            if(pathFormat != PATH_TEXT){
+                fprintf(stderr, "Error --batch supports only the text format\n");
+                return EXIT_FAILURE;
+            }
+            fileName = argv[argNum+2];
+
             if(map_ctor(&map, fileName) == -1){
                 return EXIT_FAILURE;
             }
-            search_maze(map, posR, posC, L);
+
+            PathSink sink;
+            if(path_sink_ctor(&sink, STDOUT_FILENO, pathFormat) == -1){
+                map_dtor(&map);
+                return EXIT_FAILURE;
+            }
+
+            int result = run_batch(map, argv[argNum+1], fileName, &sink);
+            if(path_sink_dtor(&sink) == -1){
+                result = -1;
+            }
+            map_dtor(&map);
+            return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
         }
 
-    map_dtor(&map);
-    return EXIT_SUCCESS;
+    fprintf(stderr, "Error unknown option %s see --help\n", argv[argNum]);
+    return EXIT_FAILURE;
 }
 
 
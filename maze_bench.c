@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+//
+// Helpers of the benchmarks, see bench.py
+// Usage: ./maze_bench generate KIND ROWS COLS [SEED] > maze.txt
+//        ./maze_bench run COMMAND [ARGS]...
+// generate writes a valid triangular maze, the same KIND, ROWS, COLS and SEED always give the same maze
+// Rows are generated and written one at a time, so that even mazes with 1e8 triangles only need memory for a few rows
+// run measures a command like time(1), see run_measured
+//
+
+// Borders of a triangle, same bits as inside maze.c
+#define LEFT_BORDER 0x01
+#define RIGHT_BORDER 0x02
+#define UPDOWN_BORDER 0x04
+
+// Share of walls a braided maze removes from a perfect one, out of BRAID_DIVISOR
+#define BRAID_SHARE 1
+#define BRAID_DIVISOR 4
+
+typedef enum {
+    MAZE_PERFECT, // Exactly one path between any two triangles
+    MAZE_BRAIDED, // Perfect maze with some walls removed, paths have cycles
+    MAZE_OPEN, // No walls inside the maze at all
+    MAZE_SERPENTINE, // A single corridor winding through every triangle, the longest possible hand rule path
+} MazeKind;
+
+const char *mazeKindNames[] = {"perfect", "braided", "open", "serpentine"};
+
+// Walls between the triangles of a row and between the row and the one above it
+typedef struct {
+    bool *rightOpen; // rightOpen[c] = side between c and c+1 is open, 1-based
+    bool *upOpen; // upOpen[c] = upper side of an UP triangle c is open, 1-based
+} RowWalls;
+
+// splitmix64, small and good enough for shuffling walls
+static inline uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Same rule as determine_triangle_type of maze.c
+static inline bool is_up(int r, int c)
+{
+    return (r + c) % 2 == 0;
+}
+
+//
+// Decides the walls of row r, every triangle but 1,1 is joined to exactly one triangle before it (a binary tree)
+// A DOWN triangle in the first column has nothing before it, so it's joined to its right neighbour which goes up instead
+//
+void carve_perfect(RowWalls *walls, int r, int cols, uint64_t *random)
+{
+    for(int c = 1; c <= cols; c++){
+        bool canLeft = c > 1;
+        bool canUp = r > 1 && is_up(r, c);
+        if(c == 2 && !is_up(r, 1)){
+            // Triangle 1 of this row hangs on this one
+            walls->rightOpen[1] = true;
+            canLeft = false;
+        }
+        if(canLeft && canUp){
+            canLeft = next_random(random) & 1;
+            canUp = !canLeft;
+        }
+        if(canLeft){
+            walls->rightOpen[c-1] = true;
+        } else if(canUp){
+            walls->upOpen[c] = true;
+        }
+    }
+}
+
+// Decides the walls of row r for kind
+void carve_row(MazeKind kind, RowWalls *walls, int r, int cols, uint64_t *random)
+{
+    memset(walls->rightOpen, 0, sizeof(bool) * ((size_t)cols + 1));
+    memset(walls->upOpen, 0, sizeof(bool) * ((size_t)cols + 1));
+
+    if(kind == MAZE_PERFECT || kind == MAZE_BRAIDED){
+        carve_perfect(walls, r, cols, random);
+    }
+    if(kind == MAZE_BRAIDED){
+        for(int c = 1; c <= cols; c++){
+            if(c < cols && next_random(random) % BRAID_DIVISOR < BRAID_SHARE){
+                walls->rightOpen[c] = true;
+            }
+            if(r > 1 && is_up(r, c) && next_random(random) % BRAID_DIVISOR < BRAID_SHARE){
+                walls->upOpen[c] = true;
+            }
+        }
+    }
+    if(kind == MAZE_OPEN || kind == MAZE_SERPENTINE){
+        for(int c = 1; c < cols; c++){
+            walls->rightOpen[c] = true;
+        }
+    }
+    if(kind == MAZE_OPEN){
+        for(int c = 1; c <= cols; c++){
+            walls->upOpen[c] = r > 1 && is_up(r, c);
+        }
+    }
+    // Odd rows are left at their right end, even rows at their left end
+    if(kind == MAZE_SERPENTINE && r > 1){
+        int c = (r-1) % 2 == 1 ? cols : 1;
+        while(c >= 1 && c <= cols && !is_up(r, c)){
+            c += (r-1) % 2 == 1 ? -1 : 1;
+        }
+        if(c >= 1 && c <= cols){
+            walls->upOpen[c] = true;
+        }
+    }
+}
+
+//
+// Writes row r, below holds the walls of the next row or NULL for the last one
+// The maze is entered through the left side of 1,1 and left through the side the last row ends at
+//
+void write_row(FILE *out, char *text, MazeKind kind, RowWalls *walls, RowWalls *below, int r, int rows, int cols)
+{
+    // Serpentine corridors of odd rows end on the right, mazes of other kinds always end at rows,cols
+    bool exitOnLeft = kind == MAZE_SERPENTINE && rows % 2 == 0;
+    for(int c = 1; c <= cols; c++){
+        unsigned borders = 0;
+        bool leftOpen = c > 1 ? walls->rightOpen[c-1] : (r == 1 || (r == rows && exitOnLeft));
+        bool rightOpen = c < cols ? walls->rightOpen[c] : r == rows && !exitOnLeft;
+        bool verticalOpen = is_up(r, c) ? walls->upOpen[c] : below != NULL && below->upOpen[c];
+        if(!leftOpen){
+            borders |= LEFT_BORDER;
+        }
+        if(!rightOpen){
+            borders |= RIGHT_BORDER;
+        }
+        if(!verticalOpen){
+            borders |= UPDOWN_BORDER;
+        }
+        text[(c-1) * 2] = (char)('0' + borders);
+        text[(c-1) * 2 + 1] = c == cols ? '\n' : ' ';
+    }
+    fwrite(text, 1, (size_t)cols * 2, out);
+}
+
+// Writes a maze of kind argv[0] with argv[1] rows and argv[2] cols, argv[3] is the optional seed
+int generate(int argc, char *argv[])
+{
+    if(argc < 3 || argc > 4){
+        fprintf(stderr, "Error generate needs perfect|braided|open|serpentine ROWS COLS [SEED]\n");
+        return EXIT_FAILURE;
+    }
+
+    int kind = -1;
+    for(int kindIndex = 0; kindIndex <= MAZE_SERPENTINE; kindIndex++){
+        if(strcmp(argv[0], mazeKindNames[kindIndex]) == 0){
+            kind = kindIndex;
+        }
+    }
+    char *end;
+    long rows = strtol(argv[1], &end, 10);
+    bool validRows = *end == '\0';
+    long cols = strtol(argv[2], &end, 10);
+    bool validCols = *end == '\0';
+    uint64_t random = argc == 4 ? strtoull(argv[3], NULL, 10) : 1;
+    if(kind == -1){
+        fprintf(stderr, "Error unknown maze kind %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // A single column can't be connected, its triangles only touch in pairs
+    if(!validRows || !validCols || rows < 1 || cols < 2 || rows * cols > 2147483647L){
+        fprintf(stderr, "Error wrong maze dimensions, at least 1 row and 2 columns are needed\n");
+        return EXIT_FAILURE;
+    }
+
+    RowWalls rowWalls[2];
+    char *text = malloc((size_t)cols * 2);
+    bool allocated = text != NULL;
+    for(int rowIndex = 0; rowIndex < 2; rowIndex++){
+        rowWalls[rowIndex].rightOpen = malloc(sizeof(bool) * ((size_t)cols + 1));
+        rowWalls[rowIndex].upOpen = malloc(sizeof(bool) * ((size_t)cols + 1));
+        allocated = allocated && rowWalls[rowIndex].rightOpen != NULL && rowWalls[rowIndex].upOpen != NULL;
+    }
+    if(!allocated){
+        fprintf(stderr, "Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+
+    // A row is written once the upper sides of the next one are known
+    printf("%ld %ld\n", rows, cols);
+    carve_row(kind, &rowWalls[0], 1, (int)cols, &random);
+    for(int r = 1; r <= rows; r++){
+        RowWalls *walls = &rowWalls[(r-1) % 2];
+        RowWalls *below = NULL;
+        if(r < rows){
+            below = &rowWalls[r % 2];
+            carve_row(kind, below, r + 1, (int)cols, &random);
+        }
+        write_row(stdout, text, kind, walls, below, r, (int)rows, (int)cols);
+    }
+
+    for(int rowIndex = 0; rowIndex < 2; rowIndex++){
+        free(rowWalls[rowIndex].rightOpen);
+        free(rowWalls[rowIndex].upOpen);
+    }
+    free(text);
+    if(fflush(stdout) != 0){
+        fprintf(stderr, "Error writing maze\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+//
+// Runs argv with stderr thrown away and prints its wall time, peak resident set and exit code as JSON onto stderr
+// bench.py can't measure the peak itself, Linux keeps the peak of the forking process across exec and a Python
+// interpreter is bigger than a small maze, this process forks while it's still tiny
+//
+int run_measured(char *argv[])
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t child = fork();
+    if(child == -1){
+        fprintf(stderr, "Error fork failed\n");
+        return EXIT_FAILURE;
+    }
+    if(child == 0){
+        int devNull = open("/dev/null", O_WRONLY);
+        if(devNull != -1){
+            dup2(devNull, STDERR_FILENO);
+            close(devNull);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if(waitpid(child, &status, 0) == -1){
+        fprintf(stderr, "Error waiting for %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    // The child is the only one this process ever waits for, so the peak of all children is its own
+    getrusage(RUSAGE_CHILDREN, &usage);
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    fprintf(stderr, "{\"seconds\": %.6f, \"peak_rss_kb\": %ld, \"exit_code\": %d}\n", seconds, usage.ru_maxrss, exitCode);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 2 && strcmp(argv[1], "generate") == 0){
+        return generate(argc - 2, argv + 2);
+    }
+    if(argc >= 3 && strcmp(argv[1], "run") == 0){
+        return run_measured(argv + 2);
+    }
+    fprintf(stderr, "Usage: %s generate KIND ROWS COLS [SEED] | run COMMAND [ARGS]...\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -39,6 +39,14 @@ run_test() {
     
     actual_output=$(./maze $test_arg $input_file)
     
+    check_output "$expected_output" "$actual_output"
+}
+
+# compares the output of the current test with the expected one, used by run_test and the tests of --serve
+check_output() {
+    expected_output=$1
+    actual_output=$2
+
     if [[ "$actual_output" == "$expected_output" ]]; then
         echo -e "${GREEN} [OK] ${NORMAL}"
         correct=$((correct + 1))
@@ -519,6 +527,432 @@ echo -e "-6 -7\n1 4 4 2 5 0 6\n1 4 4 0 4 0 2\n1 0 4 0 4 6 1\n1 2 7 1 0 4 2\n3 1
 # 23
 run_test "test_11.txt" "--test" "Invalid"
 
+# 24
+run_test "test_01.txt" "--shortest 3 7" "3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 25
+run_test "test_06.txt" "--shortest 1 3" "1,3
+1,4
+2,4
+2,5
+2,6
+2,7
+3,7"
+
+# 26
+run_test "test_01.txt" "--verbose --rpath 6 7" "6,7"
+
+# 27
+run_test "test_01.txt" "--max-steps 3 --lpath 6 1" "6,1
+6,2
+5,2
+5,3"
+
+# borders don't match so the right hand rule ends up going around in circles
+echo -e "4 4\n1 2 4 1\n5 6 3 4\n4 7 6 0\n7 3 6 6" > test_12.txt
+
+# 28
+run_test "test_12.txt" "--rpath 1 1" "1,1
+1,2
+2,2
+2,1
+2,2"
+
+echo -e "rpath 6 7\n# comment\nshortest 3 7\nlpath 3 3\nlpath 6 7" > test_queries.txt
+
+# 29
+run_test "test_01.txt" "--batch test_queries.txt" "> rpath 6 7
+6,7
+< found
+> shortest 3 7
+3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1
+< found
+> lpath 3 3
+< error
+> lpath 6 7
+6,7
+< found"
+
+# 30
+run_test "test_01.txt" "--storage planes --max-steps 3 --lpath 6 1" "6,1
+6,2
+5,2
+5,3"
+
+# 31
+run_test "test_12.txt" "--storage planes --test" "Invalid"
+
+# wide mazes, rows long enough to be read and validated in blocks
+row=$(printf '0 %.0s' {1..69})0
+echo -e "2 70\n$row\n$row" > test_13.txt
+echo -e "2 70\n$row\n${row:0:130}1${row:131}" > test_14.txt
+
+# 32
+run_test "test_13.txt" "--test" "Valid"
+
+# 33
+run_test "test_14.txt" "--test" "Invalid"
+
+# 34
+run_test "test_14.txt" "--threads 4 --test" "Invalid"
+
+# 35
+run_test "test_01.txt" "--viable 4 3" "Not viable"
+
+# 36
+run_test "test_01.txt" "--components" "3 components, 2 leading outside of the maze"
+
+# 37
+run_test "test_01.txt" "--viable 3 3" "Viable"
+
+# 38
+run_test "test_01.txt" "--reachable 6 1 1 1" "Reachable"
+
+# 39
+run_test "test_01.txt test_01.tmaze" "--compile" ""
+
+# 40
+run_test "test_01.tmaze" "--test" "Valid"
+
+# 41
+run_test "test_01.tmaze" "--viable 4 3" "Not viable"
+
+# 42
+run_test "test_01.tmaze" "--shortest 6 1" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+2,5
+2,6
+2,7
+3,7"
+
+# 43
+run_test "test_01.txt" "--storage tiles --memory-budget 1 --lpath 6 1" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+5,5
+4,5
+4,4
+3,4
+3,3
+3,2
+4,2
+4,1
+5,1
+4,1
+4,2
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 44
+run_test "test_12.txt" "--storage tiles --rpath 1 1" "1,1
+1,2
+2,2
+2,1
+2,2"
+
+# the counters go to stderr as one JSON line, the times only have to be there
+# 45
+echo -n -e "$test_count. Running test_01.txt, argument --stats --test, counters on stderr\n"
+check_output "Valid
+bytes_parsed 84
+cells_validated 42
+steps 0
+blocked_probes 0
+revisits 0
+expanded 0
+load_seconds
+validate_seconds
+search_seconds" "$(./maze --stats --test test_01.txt 2> test_stats.txt; python3 -c '
+import json
+stats = json.load(open("test_stats.txt"))
+for key in ("bytes_parsed", "cells_validated", "steps", "blocked_probes", "revisits", "expanded"):
+    print(key, stats[key])
+for key in ("load_seconds", "validate_seconds", "search_seconds"):
+    print(key if stats[key] >= 0 else key + " negative")
+')"
+
+# 46
+run_test "test_01.txt" "--search astar --shortest 6 1" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 47
+run_test "test_01.txt" "--search bidirectional --shortest 3 7" "3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 48
+run_test "test_01.txt" "--distance-field" "4 exits, 41 triangles leading outside of the maze, the furthest one 13 moves away"
+
+# 49
+run_test "test_01.txt" "--shortest 6 1" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+echo -e "6 7\n1 4 4 2 5 0 6\n1 4 4 0 4 0 2\n1 0 4 0 4 6 1\n1 2 7 1 0 4 2\n3 1 4 2 3 1 2\n4 2 5 0 4 2 5" > test_15.txt
+echo -e "# close the exit of 6,1\nset 6 1 left\nclear 4 2 left" > test_patch.txt
+./maze --components test_15.txt > /dev/null
+./maze --distance-field test_15.txt > /dev/null
+
+# 50
+run_test "test_15.txt" "--apply-patch test_patch.txt" "1 of 2 patches changed the maze"
+
+# 51
+run_test "test_15.txt" "--shortest 6 1" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+./maze --format rle --shortest 6 1 test_15.txt > test_path.bin
+
+# 52
+run_test "test_path.bin" "--decode-path" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+echo -e "4 9\n4 4 4 4 4 4 4 0 6\n1 4 4 4 4 4 4 0 6\n1 4 4 4 4 4 4 0 6\n4 4 4 4 4 4 4 0 6" > test_16.txt
+
+# 53
+run_test "test_16.txt" "--corridors" "3 corridors holding 26 triangles, crossed in one move by --format length"
+
+# 54
+run_test "test_16.txt" "--format length --rpath 1 1" "32"
+
+# 55
+run_test "test_16.txt" "--threads 2 --test-many test_02.txt test_11.txt test_01.txt" "test_02.txt: Invalid: borders aren't defined correctly at 3,5
+test_11.txt: Invalid: wrong matrix dimensions
+test_01.txt: Valid
+test_16.txt: Valid"
+
+# every query that succeeds from any triangle, enough of them for the workers of --threads to steal from each other
+for r in {1..6}; do
+    for c in {1..7}; do
+        for mode in rpath lpath shortest; do
+            ./maze --$mode $r $c test_01.txt > /dev/null 2>&1 && echo "$mode $r $c"
+        done
+    done
+done > test_queries_all.txt
+
+# 56
+run_test "test_01.txt" "--threads 4 --batch test_queries_all.txt" "$(./maze --batch test_queries_all.txt test_01.txt)"
+
+# --serve answers over a Unix socket until SIGTERM, python3 plays the client
+./maze --serve test_serve.sock 2> /dev/null &
+serve_pid=$!
+for i in {1..50}; do
+    [[ -S test_serve.sock ]] && break
+    sleep 0.1
+done
+
+# 57
+echo -n -e "$test_count. Running --serve test_serve.sock, requests test, rpath and a malformed line\n"
+check_output "> test test_01.txt
+Valid
+< found
+> rpath 6 7 test_01.txt
+6,7
+< found
+> bogus line
+< error" "$(python3 -c '
+import socket, sys
+client = socket.socket(socket.AF_UNIX)
+client.connect("test_serve.sock")
+client.sendall(b"test test_01.txt\nrpath 6 7 test_01.txt\nbogus line\n")
+client.shutdown(socket.SHUT_WR)
+while answer := client.recv(4096):
+    sys.stdout.buffer.write(answer)
+')"
+
+kill -TERM $serve_pid
+wait $serve_pid
+
+# 58
+echo -n -e "$test_count. Running --serve test_serve.sock, socket is removed after SIGTERM\n"
+check_output "removed" "$([[ -e test_serve.sock ]] && echo "left behind" || echo "removed")"
+
+# a single corridor through 24 tiles, the walk keeps the visited triangles of every tile it entered
+{ echo "1 6000"; printf '4 %.0s' {1..6000}; echo; } > test_17.txt
+
+# 59
+run_test "test_17.txt" "--storage tiles --memory-budget 2 --format length --rpath 1 1" "6000"
+
+# half of 1 MiB only has room for 21 tiles of visited triangles, the walk stops in the 22nd
+# 60
+run_test "test_17.txt" "--storage tiles --memory-budget 1 --format length --rpath 1 1" "5377"
+
+# every worker reads tiles through a cache of its own
+# 61
+run_test "test_01.txt" "--storage tiles --threads 4 --batch test_queries_all.txt" "$(./maze --batch test_queries_all.txt test_01.txt)"
+
+# bit planes are built from the cells of a compiled maze, which is still never patched as a text maze
+# 62
+run_test "test_01.tmaze" "--storage planes --batch test_queries_all.txt" "$(./maze --batch test_queries_all.txt test_01.tmaze)"
+
+# 63
+run_test "test_01.tmaze" "--storage planes --apply-patch test_patch.txt" ""
+
+# the label of triangle 1,1 in the sidecar points past the last component
+python3 -c '
+import struct
+with open("test_01.txt.components", "r+b") as sidecar:
+    sidecar.seek(40)
+    sidecar.write(struct.pack("<I", 0xFFFFFFFF))
+'
+
+# 64
+run_test "test_01.txt" "--viable 1 1" ""
+
 # print test results
 if [[ "$correct" == "$test_count" ]]; then
     echo -e "\nPassed $correct / $test_count 🎉"
@@ -530,6 +964,24 @@ fi
 # if you want individual tests comment line with the test you want to keep
 # make sure to later uncomment tho :D
 
+rm test_17.txt
+rm -f test_serve.sock
+rm test_queries_all.txt
+rm test_16.txt.corridors
+rm test_16.txt
+rm test_path.bin
+rm test_15.txt.distances
+rm test_15.txt.components
+rm test_15.txt
+rm test_patch.txt
+rm test_stats.txt
+rm test_01.tmaze
+rm test_01.txt.distances
+rm test_01.txt.components
+rm test_14.txt
+rm test_13.txt
+rm test_queries.txt
+rm test_12.txt
 rm test_11.txt
 rm test_10.txt
 rm test_09.txt